@@ -0,0 +1,272 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Offline analyzer of a B+ tree index file. Reads the meta page, walks the non-leaf levels breadth first
+ * and then the leaf chain, and prints one line per level as soon as the level is done: node count,
+ * fan-out, fill factor and its distribution, and wasted bytes. For the leaf chain it reports how often
+ * the right sibling is the next page of the file, which decides how fast range scans read from disk.
+ * Ends with a health verdict saying whether the index would gain from a rebuild.
+ *
+ * Usage: analyze <index file> [--bufs 100]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cstdlib>
+#include "btree.h"
+#include "exceptions/file_not_found_exception.h"
+
+using namespace badgerdb;
+
+/**
+ * Average fill, in percent of the page, below which the leaves are reported as worth compacting.
+ */
+const int LOWFILLPERCENT = 50;
+
+/**
+ * Share of the leaf chain, in percent, that must be in file order for range scans to read sequentially.
+ */
+const int LOWLOCALITYPERCENT = 50;
+
+/**
+ * Number of buckets of the fill distribution, each covering the same share of a page.
+ */
+const int FILLBUCKETS = 10;
+
+/**
+ * Statistics of one level of the tree.
+ */
+struct LevelStats {
+  long nodes;
+  long entries;       // children of non-leaf nodes, entries (keys for posting leaves) of leaves
+  int minEntries;
+  int maxEntries;
+  long usedBytes;
+  long fillBuckets[FILLBUCKETS];
+};
+
+void clearStats(LevelStats &stats);
+void addNode(LevelStats &stats, int entries, int usedBytes);
+void printLevel(const char *name, int level, const LevelStats &stats);
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: analyze <index file> [--bufs 100]" << std::endl;
+    return 1;
+  }
+  int bufPages = argc > 3 && strcmp(argv[2], "--bufs") == 0 ? atoi(argv[3]) : 100;
+  BufMgr *bufMgr = new BufMgr(bufPages);
+  File *file;
+  try
+  {
+    file = new BlobFile(argv[1], false);
+  }
+  catch(const FileNotFoundException &e)
+  {
+    std::cerr << "No index file " << argv[1] << std::endl;
+    return 1;
+  }
+
+  IndexMetaInfo meta;
+  PageId headerPageNum = file->getFirstPageNo();
+  Page *page;
+  bufMgr->readPage(file, headerPageNum, page);
+  memcpy(&meta, page, sizeof(meta));
+  bufMgr->unPinPage(file, headerPageNum, false);
+  if (meta.formatVersion != INDEXFORMATVERSION)
+  {
+    std::cerr << "Index format version " << meta.formatVersion << ", expected " << INDEXFORMATVERSION << std::endl;
+    return 1;
+  }
+
+  // the same layout the index computes from its options
+  int keySuffixSize = 0;
+  for (int i = 0; i < meta.numTrailingKeyAttrs; i++)
+  {
+    keySuffixSize += BTreeIndex::getAttrSize(meta.trailingKeyAttrs[i]);
+  }
+  int payloadSize = 0;
+  for (int i = 0; i < meta.numIncludeAttrs; i++)
+  {
+    payloadSize += BTreeIndex::getAttrSize(meta.includeAttrs[i]);
+  }
+  int leafEntrySize = sizeof(int) + sizeof(RecordId) + keySuffixSize + payloadSize;
+  int leafOccupancy = ( Page::SIZE - 2 * sizeof( PageId ) ) / leafEntrySize;
+  int nodeOccupancy = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + keySuffixSize + sizeof( PageId ) );
+  const char *formatNames[] = {"slotted", "posting", "compressed"};
+
+  std::cout << "index " << argv[1] << " on " << std::string(meta.relationName, strnlen(meta.relationName, sizeof(meta.relationName)))
+            << " offset " << meta.attrByteOffset << "\n"
+            << "format " << formatNames[meta.leafFormat] << ", key suffix " << keySuffixSize << " bytes, payload "
+            << payloadSize << " bytes\n"
+            << "height " << meta.height << ", " << meta.numEntries << " entries, " << meta.numLeafPages << " leaves, "
+            << meta.numInternalPages << " non-leaf nodes, " << meta.numOverflowPages << " overflow pages, "
+            << meta.numBloomPages << " Bloom filter pages" << std::endl;
+
+  // non-leaf levels, breadth first, holding only the page numbers of the next level
+  long totalWasted = 0;
+  long internalNodes = 0;
+  long leavesBelow = 0;
+  std::vector<PageId> levelPages;
+  if (!meta.rootIsLeaf)
+  {
+    levelPages.push_back(meta.rootPageNo);
+  }
+  while (!levelPages.empty())
+  {
+    LevelStats stats;
+    clearStats(stats);
+    std::vector<PageId> nextPages;
+    int level = 0;
+    for (PageId pageNum : levelPages)
+    {
+      bufMgr->readPage(file, pageNum, page);
+      NonLeafNodeInt *node = (NonLeafNodeInt *)page;
+      PageId *pageNos = (PageId *)(node->keyArray + nodeOccupancy);
+      int children = 0;
+      while (children <= nodeOccupancy && pageNos[children] != 0)
+      {
+        nextPages.push_back(pageNos[children]);
+        children++;
+      }
+      level = node->level;
+      bufMgr->unPinPage(file, pageNum, false);
+      addNode(stats, children, sizeof(int) + (children - 1) * (sizeof(int) + keySuffixSize) + children * sizeof(PageId));
+    }
+    printLevel("non-leaf", level, stats);
+    totalWasted += stats.nodes * Page::SIZE - stats.usedBytes;
+    internalNodes += stats.nodes;
+    if (level == 1)
+    {
+      leavesBelow = nextPages.size();
+      break;
+    }
+    levelPages.swap(nextPages);
+  }
+
+  // the leaves, along the chain
+  LevelStats stats;
+  clearStats(stats);
+  long adjacent = 0;
+  long backward = 0;
+  long distance = 0;
+  PageId prevPageNum = 0;
+  for (PageId pageNum = meta.firstLeafPageNo; pageNum != 0; )
+  {
+    bufMgr->readPage(file, pageNum, page);
+    int entries;
+    int usedBytes;
+    if (meta.leafFormat == POSTINGLEAF)
+    {
+      PostingLeafNodeInt *leaf = (PostingLeafNodeInt *)page;
+      entries = leaf->numKeys;
+      usedBytes = Page::SIZE - POSTINGLEAFDATASIZE + leaf->numBytes;
+    }
+    else if (meta.leafFormat == COMPRESSEDLEAF)
+    {
+      CompressedLeafNodeInt *leaf = (CompressedLeafNodeInt *)page;
+      entries = leaf->numEntries;
+      usedBytes = Page::SIZE - COMPRESSEDLEAFDATASIZE + entries * (leaf->keyWidth + leaf->pageWidth + leaf->slotWidth);
+    }
+    else
+    {
+      LeafNodeInt *leaf = (LeafNodeInt *)page;
+      RecordId *rids = (RecordId *)(leaf->keyArray + leafOccupancy);
+      entries = 0;
+      while (entries < leafOccupancy && rids[entries].page_number != 0)
+      {
+        entries++;
+      }
+      usedBytes = 2 * sizeof(PageId) + entries * leafEntrySize;
+    }
+    addNode(stats, entries, usedBytes);
+
+    if (prevPageNum != 0)
+    {
+      adjacent += pageNum == prevPageNum + 1;
+      backward += pageNum < prevPageNum;
+      distance += pageNum > prevPageNum ? pageNum - prevPageNum : prevPageNum - pageNum;
+    }
+    prevPageNum = pageNum;
+    PageId nextPageNum = ((LeafNodeInt *)page)->rightSibPageNo;
+    bufMgr->unPinPage(file, pageNum, false);
+    pageNum = nextPageNum;
+  }
+  printLevel("leaf", 0, stats);
+  totalWasted += stats.nodes * Page::SIZE - stats.usedBytes;
+  long links = std::max(stats.nodes - 1, 1L);
+  double adjacentPercent = 100.0 * adjacent / links;
+  std::cout << std::fixed << std::setprecision(1)
+            << "leaf chain: " << adjacent << " of " << links << " links to the next page (" << adjacentPercent << "%), "
+            << backward << " backward, average distance " << (double)distance / links << " pages\n"
+            << "wasted " << totalWasted << " bytes in " << internalNodes + stats.nodes << " pages" << std::endl;
+
+  // health verdict
+  double leafFill = stats.nodes == 0 ? 100 : 100.0 * stats.usedBytes / (stats.nodes * Page::SIZE);
+  bool healthy = true;
+  if (internalNodes != meta.numInternalPages || stats.nodes != meta.numLeafPages || (!meta.rootIsLeaf && leavesBelow != stats.nodes))
+  {
+    std::cout << "health: page counts disagree with the meta page or the leaf chain is broken, rebuild" << std::endl;
+    healthy = false;
+  }
+  if (stats.nodes > 1 && leafFill < LOWFILLPERCENT)
+  {
+    std::cout << "health: leaves " << leafFill << "% full, compact to read fewer pages" << std::endl;
+    healthy = false;
+  }
+  if (stats.nodes > 1 && adjacentPercent < LOWLOCALITYPERCENT)
+  {
+    std::cout << "health: leaf chain out of file order, rebuild in key order for sequential range scans" << std::endl;
+    healthy = false;
+  }
+  if (healthy)
+  {
+    std::cout << "health: ok" << std::endl;
+  }
+
+  delete file;
+  delete bufMgr;
+  return 0;
+}
+
+void clearStats(LevelStats &stats)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+void addNode(LevelStats &stats, int entries, int usedBytes)
+{
+  if (stats.nodes == 0 || entries < stats.minEntries)
+  {
+    stats.minEntries = entries;
+  }
+  stats.maxEntries = std::max(stats.maxEntries, entries);
+  stats.nodes++;
+  stats.entries += entries;
+  stats.usedBytes += usedBytes;
+  stats.fillBuckets[std::min(usedBytes * FILLBUCKETS / (int)Page::SIZE, FILLBUCKETS - 1)]++;
+}
+
+void printLevel(const char *name, int level, const LevelStats &stats)
+{
+  long nodes = std::max(stats.nodes, 1L);
+  std::cout << std::fixed << std::setprecision(1)
+            << name << " level " << level << ": " << stats.nodes << " pages, "
+            << (level == 0 ? "entries" : "fan-out") << " min " << stats.minEntries << " avg "
+            << (double)stats.entries / nodes << " max " << stats.maxEntries
+            << ", fill " << 100.0 * stats.usedBytes / (nodes * Page::SIZE) << "%, wasted "
+            << stats.nodes * Page::SIZE - stats.usedBytes << " bytes, pages per fill decile";
+  for (int i = 0; i < FILLBUCKETS; i++)
+  {
+    std::cout << " " << stats.fillBuckets[i];
+  }
+  std::cout << std::endl;
+}
@@ -0,0 +1,393 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Microbenchmarks of the B+ tree index: bulk build, sequential and random insert, point lookup, short
+ * and long range scans and a mixed workload, over every combination of relation size, key distribution
+ * and buffer pool size given on the command line. Results are written as JSON in the layout of Google
+ * Benchmark, one entry per benchmark, so they can be compared across runs.
+ *
+ * Usage: bench [--sizes 10000,100000] [--dists forward,backward,random,zipfian] [--bufs 100,1000]
+ *              [--ops 100000] [--format slotted|posting|compressed] [--out results.json]
+ */
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include "btree.h"
+#include "workload.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Globals
+// -----------------------------------------------------------------------------
+const std::string relationName = "benchRel";
+
+/**
+ * Number of keys a short range scan covers.
+ */
+const int SHORTSCANKEYS = 100;
+
+/**
+ * Percentage of the relation a long range scan covers.
+ */
+const int LONGSCANPERCENT = 10;
+
+/**
+ * Percentage of the operations of the mixed workload that are inserts, the rest are point lookups.
+ */
+const int MIXEDINSERTPERCENT = 5;
+
+/**
+ * Result of one benchmark run.
+ */
+struct BenchResult {
+  std::string name;
+  int relationSize;
+  KeyDistribution dist;
+  int bufPages;
+  long iterations;    // operations timed
+  long items;         // entries inserted, found or scanned
+  double seconds;
+  BufStatsSnapshot bufStats;
+};
+
+std::vector<BenchResult> results;
+
+// -----------------------------------------------------------------------------
+// Forward declarations
+// -----------------------------------------------------------------------------
+std::vector<int> parseIntList(const char *arg);
+void runConfig(int relationSize, KeyDistribution dist, int bufPages, long ops, const IndexOptions &options);
+int scanRange(BTreeIndex *index, int lowVal, int highVal);
+void writeResults(std::ostream &out, const char *executable, long ops, const IndexOptions &options);
+
+/**
+ * Times a benchmark body and records its result together with the buffer statistics it produced.
+ */
+class BenchTimer {
+ public:
+  BenchTimer(BufMgr *bufMgr) : bufMgr(bufMgr)
+  {
+    bufMgr->clearBufStats();
+    start = std::chrono::steady_clock::now();
+  }
+
+  void stop(const std::string &name, int relationSize, KeyDistribution dist, int bufPages, long iterations, long items)
+  {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    BenchResult result;
+    result.name = name;
+    result.relationSize = relationSize;
+    result.dist = dist;
+    result.bufPages = bufPages;
+    result.iterations = iterations;
+    result.items = items;
+    result.seconds = elapsed.count();
+    result.bufStats = bufMgr->getBufStatsSnapshot();
+    results.push_back(result);
+    std::cerr << name << "/" << relationSize << "/" << distributionName(dist) << "/" << bufPages << ": "
+              << result.seconds * 1e9 / std::max(iterations, 1L) << " ns/op" << std::endl;
+  }
+
+ private:
+  BufMgr *bufMgr;
+  std::chrono::steady_clock::time_point start;
+};
+
+int main(int argc, char **argv)
+{
+  std::vector<int> sizes = {10000, 100000, 1000000};
+  std::vector<KeyDistribution> dists = {FORWARD, BACKWARD, RANDOM, ZIPFIAN};
+  std::vector<int> bufs = {100, 1000};
+  long ops = 100000;
+  IndexOptions options;
+  const char *outName = NULL;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "--sizes") == 0)
+    {
+      sizes = parseIntList(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "--bufs") == 0)
+    {
+      bufs = parseIntList(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "--ops") == 0)
+    {
+      ops = atol(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "--out") == 0)
+    {
+      outName = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "--dists") == 0)
+    {
+      dists.clear();
+      std::stringstream list(argv[i + 1]);
+      std::string name;
+      while (std::getline(list, name, ','))
+      {
+        KeyDistribution dist;
+        if (!parseDistribution(name, dist))
+        {
+          std::cerr << "Unknown key distribution " << name << std::endl;
+          return 1;
+        }
+        dists.push_back(dist);
+      }
+    }
+    else if (strcmp(argv[i], "--format") == 0)
+    {
+      std::string format = argv[i + 1];
+      options.leafFormat = format == "posting" ? POSTINGLEAF : (format == "compressed" ? COMPRESSEDLEAF : SLOTTEDLEAF);
+    }
+    else
+    {
+      std::cerr << "Unknown option " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+
+  for (int relationSize : sizes)
+  {
+    for (KeyDistribution dist : dists)
+    {
+      for (int bufPages : bufs)
+      {
+        runConfig(relationSize, dist, bufPages, ops, options);
+      }
+    }
+  }
+
+  if (outName != NULL)
+  {
+    std::ofstream out(outName);
+    writeResults(out, argv[0], ops, options);
+  }
+  else
+  {
+    writeResults(std::cout, argv[0], ops, options);
+  }
+  return 0;
+}
+
+std::vector<int> parseIntList(const char *arg)
+{
+  std::vector<int> values;
+  std::stringstream list(arg);
+  std::string value;
+  while (std::getline(list, value, ','))
+  {
+    values.push_back(atoi(value.c_str()));
+  }
+  return values;
+}
+
+// -----------------------------------------------------------------------------
+// runConfig
+// -----------------------------------------------------------------------------
+
+void runConfig(int relationSize, KeyDistribution dist, int bufPages, long ops, const IndexOptions &options)
+{
+  createWorkloadRelation(relationName, relationSize, dist);
+  BufMgr *bufMgr = new BufMgr(bufPages);
+  std::string indexName;
+  KeyGenerator keys(dist, relationSize, 2);
+  // inserted entries point at the first record, the index never reads the records
+  RecordId rid;
+  rid.page_number = 1;
+  rid.slot_number = 1;
+
+  BTreeIndex *index;
+  {
+    BenchTimer timer(bufMgr);
+    index = new BTreeIndex(relationName, indexName, bufMgr, offsetof(WorkloadRecord, i), INTEGER, options);
+    timer.stop("build", relationSize, dist, bufPages, relationSize, relationSize);
+  }
+
+  {
+    BenchTimer timer(bufMgr);
+    long found = 0;
+    for (long i = 0; i < ops; i++)
+    {
+      int key = keys.nextKey();
+      RecordId outRid;
+      found += index->lookupEntry(&key, outRid);
+    }
+    timer.stop("lookup", relationSize, dist, bufPages, ops, found);
+  }
+
+  {
+    long numScans = std::max(ops / SHORTSCANKEYS, 1L);
+    BenchTimer timer(bufMgr);
+    long scanned = 0;
+    for (long i = 0; i < numScans; i++)
+    {
+      int lowVal = keys.nextKey();
+      scanned += scanRange(index, lowVal, lowVal + SHORTSCANKEYS);
+    }
+    timer.stop("scan_short", relationSize, dist, bufPages, numScans, scanned);
+  }
+
+  {
+    int scanKeys = std::max((long)relationSize * LONGSCANPERCENT / 100, 1L);
+    long numScans = std::max(ops / scanKeys, 1L);
+    BenchTimer timer(bufMgr);
+    long scanned = 0;
+    for (long i = 0; i < numScans; i++)
+    {
+      int lowVal = keys.nextKey() % std::max(relationSize - scanKeys, 1);
+      scanned += scanRange(index, lowVal, lowVal + scanKeys);
+    }
+    timer.stop("scan_long", relationSize, dist, bufPages, numScans, scanned);
+  }
+
+  {
+    // keys past the largest one, each insert appends to the rightmost leaf
+    BenchTimer timer(bufMgr);
+    for (long i = 0; i < ops; i++)
+    {
+      int key = relationSize + i;
+      index->insertEntry(&key, rid);
+    }
+    index->flushInsertBuffer();
+    timer.stop("insert_sequential", relationSize, dist, bufPages, ops, ops);
+  }
+
+  {
+    BenchTimer timer(bufMgr);
+    for (long i = 0; i < ops; i++)
+    {
+      int key = keys.nextKey();
+      index->insertEntry(&key, rid);
+    }
+    index->flushInsertBuffer();
+    timer.stop("insert_random", relationSize, dist, bufPages, ops, ops);
+  }
+
+  {
+    BenchTimer timer(bufMgr);
+    long items = 0;
+    for (long i = 0; i < ops; i++)
+    {
+      int key = keys.nextKey();
+      if ((int)(keys.getRng()() % 100) < MIXEDINSERTPERCENT)
+      {
+        index->insertEntry(&key, rid);
+        items++;
+      }
+      else
+      {
+        RecordId outRid;
+        items += index->lookupEntry(&key, outRid);
+      }
+    }
+    index->flushInsertBuffer();
+    timer.stop("mixed", relationSize, dist, bufPages, ops, items);
+  }
+
+  delete index;
+  delete bufMgr;
+  try
+  {
+    File::remove(indexName);
+  }
+  catch(const FileNotFoundException &e)
+  {
+  }
+  try
+  {
+    File::remove(relationName);
+  }
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+// -----------------------------------------------------------------------------
+// scanRange
+// -----------------------------------------------------------------------------
+
+int scanRange(BTreeIndex *index, int lowVal, int highVal)
+{
+  RecordId scanRid;
+  int numResults = 0;
+  try
+  {
+    index->startScan(&lowVal, GTE, &highVal, LT);
+  }
+  catch(const NoSuchKeyFoundException &e)
+  {
+    return 0;
+  }
+
+  while (1)
+  {
+    try
+    {
+      index->scanNext(scanRid);
+      numResults++;
+    }
+    catch(const IndexScanCompletedException &e)
+    {
+      break;
+    }
+  }
+  index->endScan();
+  return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// writeResults
+// -----------------------------------------------------------------------------
+
+void writeResults(std::ostream &out, const char *executable, long ops, const IndexOptions &options)
+{
+  char date[32];
+  std::time_t now = std::time(NULL);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+  const char *formatNames[] = {"slotted", "posting", "compressed"};
+
+  out << "{\n  \"context\": {\n"
+      << "    \"date\": \"" << date << "\",\n"
+      << "    \"executable\": \"" << executable << "\",\n"
+      << "    \"page_size\": " << Page::SIZE << ",\n"
+      << "    \"leaf_format\": \"" << formatNames[options.leafFormat] << "\",\n"
+      << "    \"ops\": " << ops << "\n"
+      << "  },\n  \"benchmarks\": [";
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const BenchResult &r = results[i];
+    long iterations = std::max(r.iterations, 1L);
+    out << (i == 0 ? "\n" : ",\n")
+        << "    {\n"
+        << "      \"name\": \"" << r.name << "/" << r.relationSize << "/" << distributionName(r.dist) << "/" << r.bufPages << "\",\n"
+        << "      \"run_name\": \"" << r.name << "\",\n"
+        << "      \"relation_size\": " << r.relationSize << ",\n"
+        << "      \"distribution\": \"" << distributionName(r.dist) << "\",\n"
+        << "      \"buffer_pages\": " << r.bufPages << ",\n"
+        << "      \"iterations\": " << r.iterations << ",\n"
+        << "      \"real_time\": " << r.seconds * 1e9 / iterations << ",\n"
+        << "      \"time_unit\": \"ns\",\n"
+        << "      \"items_per_second\": " << (r.seconds > 0 ? r.items / r.seconds : 0) << ",\n"
+        << "      \"buffer_accesses\": " << r.bufStats.accesses << ",\n"
+        << "      \"disk_reads\": " << r.bufStats.diskreads << ",\n"
+        << "      \"disk_writes\": " << r.bufStats.diskwrites << "\n"
+        << "    }";
+  }
+  out << "\n  ]\n}\n";
+}
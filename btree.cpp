@@ -5,6 +5,8 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <cmath>
 #include "btree.h"
 #include "filescan.h"
 #include "exceptions/bad_index_info_exception.h"
@@ -19,9 +21,485 @@
 
 //#define DEBUG
 
+// Define BTREETRACE to record the pages read, the splits and the comparisons of every operation, see
+// BTreeIndex::dumpTraces. Without it the trace hooks are empty.
+#ifdef BTREETRACE
+#define TRACEOPERATION(op, key) TraceScope traceScope(this, op, key)
+#define TRACEBEGIN(op, key) beginTrace(op, key)
+#define TRACEEND() endTrace()
+#define TRACEPAGE(pageNo, level) tracePage(pageNo, level)
+#define TRACESPLIT() currentTrace.splits++
+#define TRACECOMPARE() currentTrace.comparisons++
+#else
+#define TRACEOPERATION(op, key)
+#define TRACEBEGIN(op, key)
+#define TRACEEND()
+#define TRACEPAGE(pageNo, level)
+#define TRACESPLIT()
+#define TRACECOMPARE()
+#endif
+
 namespace badgerdb
 {
 
+/**
+ * Compare key suffixes made of one attribute of type T. Instantiated for the common composite key
+ * shapes, INTEGER+INTEGER and INTEGER+DOUBLE.
+ */
+template <class T>
+static int compareSuffix(const char *suffix1, const char *suffix2)
+{
+  T val1, val2;
+  memcpy(&val1, suffix1, sizeof(T));
+  memcpy(&val2, suffix2, sizeof(T));
+  return val1 < val2 ? -1 : (val2 < val1 ? 1 : 0);
+}
+
+/**
+ * Compare key suffixes made of an attribute of type T1 followed by one of type T2.
+ */
+template <class T1, class T2>
+static int compareSuffix2(const char *suffix1, const char *suffix2)
+{
+  int cmp = compareSuffix<T1>(suffix1, suffix2);
+  return cmp != 0 ? cmp : compareSuffix<T2>(suffix1 + sizeof(T1), suffix2 + sizeof(T1));
+}
+
+/**
+ * Write an unsigned value as a varint: seven bits per byte, lowest bits first, with the high bit set
+ * on every byte but the last.
+ * @return  Number of bytes written
+ */
+static int putVarint(char *out, unsigned int val)
+{
+  int numBytes = 0;
+  while (val >= 0x80)
+  {
+    out[numBytes++] = (char)(val | 0x80);
+    val >>= 7;
+  }
+  out[numBytes++] = (char)val;
+  return numBytes;
+}
+
+/**
+ * Read a varint written by putVarint() and move in past it.
+ */
+static unsigned int getVarint(const char *&in)
+{
+  unsigned int val = 0;
+  int shift = 0;
+  unsigned char byte;
+  do
+  {
+    byte = (unsigned char)*in++;
+    val |= (unsigned int)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return val;
+}
+
+/**
+ * Order of rids in a posting list.
+ */
+static bool ridLess(const RecordId &rid1, const RecordId &rid2)
+{
+  if (rid1.page_number != rid2.page_number)
+  {
+    return rid1.page_number < rid2.page_number;
+  }
+  return rid1.slot_number < rid2.slot_number;
+}
+
+/**
+ * Encode sorted rids as described for PostingLeafNodeInt.
+ * @return  Number of bytes written
+ */
+static int encodeRids(const RecordId *rids, int numRids, char *out)
+{
+  int numBytes = 0;
+  PageId prevPageNo = 0;
+  SlotId prevSlotNo = 0;
+  for (int i = 0; i < numRids; i++)
+  {
+    numBytes += putVarint(out + numBytes, rids[i].page_number - prevPageNo);
+    numBytes += putVarint(out + numBytes, rids[i].page_number == prevPageNo ? rids[i].slot_number - prevSlotNo : rids[i].slot_number);
+    prevPageNo = rids[i].page_number;
+    prevSlotNo = rids[i].slot_number;
+  }
+  return numBytes;
+}
+
+/**
+ * Decode rids written by encodeRids().
+ */
+static void decodeRids(const char *in, int numRids, RecordId *out)
+{
+  PageId pageNo = 0;
+  SlotId slotNo = 0;
+  for (int i = 0; i < numRids; i++)
+  {
+    PageId pageDelta = getVarint(in);
+    unsigned int slotVal = getVarint(in);
+    if (pageDelta == 0)
+    {
+      slotNo += slotVal;
+    }
+    else
+    {
+      pageNo += pageDelta;
+      slotNo = slotVal;
+    }
+    out[i].page_number = pageNo;
+    out[i].slot_number = slotNo;
+  }
+}
+
+/**
+ * Number of bytes needed to store offsets up to range: 0, 1, 2 or 4.
+ */
+static int offsetWidth(unsigned int range)
+{
+  if (range == 0)
+  {
+    return 0;
+  }
+  if (range <= 0xff)
+  {
+    return 1;
+  }
+  return range <= 0xffff ? 2 : 4;
+}
+
+/**
+ * Store offsets as T, the unsigned type of their width.
+ */
+template <class T>
+static void storeOffsetsAs(const unsigned int *offsets, int num, char *out)
+{
+  T *vals = (T *)out;
+  for (int i = 0; i < num; i++)
+  {
+    vals[i] = (T)offsets[i];
+  }
+}
+
+/**
+ * Store offsets in width bytes each.
+ */
+static void storeOffsets(const unsigned int *offsets, int num, int width, char *out)
+{
+  switch (width)
+  {
+    case 0:
+      break;
+    case 1:
+      storeOffsetsAs<unsigned char>(offsets, num, out);
+      break;
+    case 2:
+      storeOffsetsAs<unsigned short>(offsets, num, out);
+      break;
+    default:
+      storeOffsetsAs<unsigned int>(offsets, num, out);
+      break;
+  }
+}
+
+/**
+ * Decode key offsets stored as T. The loops of the load functions have no dependencies between
+ * iterations, so the compiler turns them into SIMD widening adds.
+ */
+template <class T>
+static void loadKeysAs(const char *in, int num, int baseKey, int *keys)
+{
+  const T *vals = (const T *)in;
+  for (int i = 0; i < num; i++)
+  {
+    keys[i] = (int)((unsigned int)baseKey + vals[i]);
+  }
+}
+
+static void loadKeys(const char *in, int num, int width, int baseKey, int *keys)
+{
+  switch (width)
+  {
+    case 0:
+      std::fill(keys, keys + num, baseKey);
+      break;
+    case 1:
+      loadKeysAs<unsigned char>(in, num, baseKey, keys);
+      break;
+    case 2:
+      loadKeysAs<unsigned short>(in, num, baseKey, keys);
+      break;
+    default:
+      loadKeysAs<unsigned int>(in, num, baseKey, keys);
+      break;
+  }
+}
+
+/**
+ * Decode rid page number offsets stored as T.
+ */
+template <class T>
+static void loadPageNosAs(const char *in, int num, PageId basePageNo, RecordId *rids)
+{
+  const T *vals = (const T *)in;
+  for (int i = 0; i < num; i++)
+  {
+    rids[i].page_number = basePageNo + vals[i];
+  }
+}
+
+static void loadPageNos(const char *in, int num, int width, PageId basePageNo, RecordId *rids)
+{
+  switch (width)
+  {
+    case 0:
+      for (int i = 0; i < num; i++)
+      {
+        rids[i].page_number = basePageNo;
+      }
+      break;
+    case 1:
+      loadPageNosAs<unsigned char>(in, num, basePageNo, rids);
+      break;
+    case 2:
+      loadPageNosAs<unsigned short>(in, num, basePageNo, rids);
+      break;
+    default:
+      loadPageNosAs<unsigned int>(in, num, basePageNo, rids);
+      break;
+  }
+}
+
+/**
+ * Decode rid slot number offsets stored as T.
+ */
+template <class T>
+static void loadSlotNosAs(const char *in, int num, SlotId baseSlotNo, RecordId *rids)
+{
+  const T *vals = (const T *)in;
+  for (int i = 0; i < num; i++)
+  {
+    rids[i].slot_number = (SlotId)(baseSlotNo + vals[i]);
+  }
+}
+
+static void loadSlotNos(const char *in, int num, int width, SlotId baseSlotNo, RecordId *rids)
+{
+  switch (width)
+  {
+    case 0:
+      for (int i = 0; i < num; i++)
+      {
+        rids[i].slot_number = baseSlotNo;
+      }
+      break;
+    case 1:
+      loadSlotNosAs<unsigned char>(in, num, baseSlotNo, rids);
+      break;
+    default:
+      loadSlotNosAs<unsigned short>(in, num, baseSlotNo, rids);
+      break;
+  }
+}
+
+/**
+ * Bytes taken by an array of a compressed leaf, including the padding that keeps the next one aligned.
+ */
+static int compressedArraySize(int numEntries, int width)
+{
+  return (numEntries * width + 3) & ~3;
+}
+
+/**
+ * Write sorted entries into a compressed leaf, choosing the narrowest widths for them.
+ * @return  False, leaving the leaf untouched, if the entries do not fit
+ */
+static bool encodeCompressedLeaf(const int *keys, const RecordId *rids, int numEntries, CompressedLeafNodeInt *leaf)
+{
+  PageId minPageNo = numEntries > 0 ? rids[0].page_number : 0;
+  PageId maxPageNo = minPageNo;
+  SlotId minSlotNo = numEntries > 0 ? rids[0].slot_number : 0;
+  SlotId maxSlotNo = minSlotNo;
+  for (int i = 1; i < numEntries; i++)
+  {
+    minPageNo = std::min(minPageNo, rids[i].page_number);
+    maxPageNo = std::max(maxPageNo, rids[i].page_number);
+    minSlotNo = std::min(minSlotNo, rids[i].slot_number);
+    maxSlotNo = std::max(maxSlotNo, rids[i].slot_number);
+  }
+  int baseKey = numEntries > 0 ? keys[0] : 0;
+  int keyWidth = numEntries > 0 ? offsetWidth((unsigned int)keys[numEntries - 1] - (unsigned int)baseKey) : 0;
+  int pageWidth = offsetWidth(maxPageNo - minPageNo);
+  int slotWidth = offsetWidth(maxSlotNo - minSlotNo);
+  int keyBytes = compressedArraySize(numEntries, keyWidth);
+  int pageBytes = compressedArraySize(numEntries, pageWidth);
+  if (keyBytes + pageBytes + numEntries * slotWidth > COMPRESSEDLEAFDATASIZE)
+  {
+    return false;
+  }
+
+  leaf->numEntries = numEntries;
+  leaf->baseKey = baseKey;
+  leaf->basePageNo = minPageNo;
+  leaf->baseSlotNo = minSlotNo;
+  leaf->keyWidth = keyWidth;
+  leaf->pageWidth = pageWidth;
+  leaf->slotWidth = slotWidth;
+  unsigned int offsets[COMPRESSEDLEAFMAXENTRIES + 1] = {};
+  for (int i = 0; i < numEntries; i++)
+  {
+    offsets[i] = (unsigned int)keys[i] - (unsigned int)baseKey;
+  }
+  storeOffsets(offsets, numEntries, keyWidth, leaf->data);
+  for (int i = 0; i < numEntries; i++)
+  {
+    offsets[i] = rids[i].page_number - minPageNo;
+  }
+  storeOffsets(offsets, numEntries, pageWidth, leaf->data + keyBytes);
+  for (int i = 0; i < numEntries; i++)
+  {
+    offsets[i] = rids[i].slot_number - minSlotNo;
+  }
+  storeOffsets(offsets, numEntries, slotWidth, leaf->data + keyBytes + pageBytes);
+  return true;
+}
+
+/**
+ * Decode all entries of a compressed leaf.
+ */
+static void decodeCompressedLeaf(const CompressedLeafNodeInt *leaf, int *keys, RecordId *rids)
+{
+  int numEntries = leaf->numEntries;
+  int keyBytes = compressedArraySize(numEntries, leaf->keyWidth);
+  int pageBytes = compressedArraySize(numEntries, leaf->pageWidth);
+  loadKeys(leaf->data, numEntries, leaf->keyWidth, leaf->baseKey, keys);
+  loadPageNos(leaf->data + keyBytes, numEntries, leaf->pageWidth, leaf->basePageNo, rids);
+  loadSlotNos(leaf->data + keyBytes + pageBytes, numEntries, leaf->slotWidth, leaf->baseSlotNo, rids);
+}
+
+std::uint64_t hashKey(int key)
+{
+  std::uint64_t hash = (std::uint64_t)(unsigned int)key + 0x9e3779b97f4a7c15ULL;
+  hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+  return hash ^ (hash >> 31);
+}
+
+/**
+ * Position of the first key not less than key, like std::lower_bound. The position is first guessed by
+ * interpolating between the smallest and the largest key, then the search widens from the guess in
+ * doubling steps until the key is bracketed, which takes few steps when the keys are evenly spread.
+ */
+static int predictSlot(const int *keys, int numKeys, int key)
+{
+  if (numKeys == 0 || key <= keys[0])
+  {
+    return 0;
+  }
+  if (key > keys[numKeys - 1])
+  {
+    return numKeys;
+  }
+  // keys[low] < key <= keys[high] from here on
+  int guess = (int)(((double)key - keys[0]) / ((double)keys[numKeys - 1] - keys[0]) * (numKeys - 1));
+  int low = 0;
+  int high = numKeys - 1;
+  int step = 1;
+  if (keys[guess] < key)
+  {
+    low = guess;
+    while (low + step < high && keys[low + step] < key)
+    {
+      low += step;
+      step *= 2;
+    }
+    high = std::min(high, low + step);
+  }
+  else
+  {
+    high = guess;
+    while (high - step > low && keys[high - step] >= key)
+    {
+      high -= step;
+      step *= 2;
+    }
+    low = std::max(low, high - step);
+  }
+  return std::lower_bound(keys + low + 1, keys + high, key) - keys;
+}
+
+/**
+ * A posting list of a posting leaf, as read by readPostingList().
+ */
+struct PostingList
+{
+  int key;
+  int numRids;
+  bool overflow;
+  // overflow lists only
+  PageId headPageNo;
+  PageId tailPageNo;
+  // lists stored in the leaf only
+  int numRidBytes;
+  const char *rids;
+  // first byte after the list
+  const char *end;
+};
+
+/**
+ * Read the posting list starting at in.
+ */
+static void readPostingList(const char *in, PostingList &list)
+{
+  memcpy(&list.key, in, sizeof(int));
+  in += sizeof(int);
+  unsigned int countAndFlag = getVarint(in);
+  list.numRids = countAndFlag >> 1;
+  list.overflow = (countAndFlag & 1) != 0;
+  if (list.overflow)
+  {
+    memcpy(&list.headPageNo, in, sizeof(PageId));
+    memcpy(&list.tailPageNo, in + sizeof(PageId), sizeof(PageId));
+    in += 2 * sizeof(PageId);
+    list.numRidBytes = 0;
+    list.rids = NULL;
+  }
+  else
+  {
+    list.numRidBytes = getVarint(in);
+    list.rids = in;
+    in += list.numRidBytes;
+  }
+  list.end = in;
+}
+
+/**
+ * Write a posting list, taking the rids of a list stored in the leaf from list.rids.
+ * @return  Number of bytes written
+ */
+static int writePostingList(char *out, const PostingList &list)
+{
+  memcpy(out, &list.key, sizeof(int));
+  int numBytes = sizeof(int);
+  numBytes += putVarint(out + numBytes, ((unsigned int)list.numRids << 1) | (list.overflow ? 1 : 0));
+  if (list.overflow)
+  {
+    memcpy(out + numBytes, &list.headPageNo, sizeof(PageId));
+    memcpy(out + numBytes + sizeof(PageId), &list.tailPageNo, sizeof(PageId));
+    numBytes += 2 * sizeof(PageId);
+  }
+  else
+  {
+    numBytes += putVarint(out + numBytes, list.numRidBytes);
+    memcpy(out + numBytes, list.rids, list.numRidBytes);
+    numBytes += list.numRidBytes;
+  }
+  return numBytes;
+}
+
 
 
 
@@ -29,19 +507,118 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
         std::string & outIndexName,
         BufMgr *bufMgrIn,
         const int attrByteOffset,
-        const Datatype attrType)
+        const Datatype attrType,
+        const IndexOptions &options)
 {
 
   bufMgr = bufMgrIn;
-  leafOccupancy = INTARRAYLEAFSIZE;
-  nodeOccupancy = INTARRAYNONLEAFSIZE;
+  this->attrByteOffset = attrByteOffset;
+  attributeType = attrType;
+  includeAttrs = options.includeAttrs;
+  trailingKeyAttrs = options.trailingKeyAttrs;
+  leafFormat = options.leafFormat;
+  bloomFilter = options.bloomFilter;
+  learnedRouting = options.learnedRouting;
+  insertBufferSize = options.insertBufferSize;
+  payloadSize = 0;
+  for (size_t i = 0; i < includeAttrs.size(); i++)
+  {
+    payloadSize += getAttrSize(includeAttrs[i]);
+  }
+  keySuffixSize = 0;
+  for (size_t i = 0; i < trailingKeyAttrs.size(); i++)
+  {
+    keySuffixSize += getAttrSize(trailingKeyAttrs[i]);
+  }
+  // key suffix and payload bytes share the leaf with keys and rids, without them this is INTARRAYLEAFSIZE
+  leafOccupancy = ( Page::SIZE - 2 * sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) + keySuffixSize + payloadSize );
+  // separators carry the key suffix too, with a single key attribute this is INTARRAYNONLEAFSIZE
+  nodeOccupancy = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + keySuffixSize + sizeof( PageId ) );
   scanExecuting = false;
+  overflowPageNum = 0;
+  memset(&counters, 0, sizeof(counters));
+  epoch = 0;
+  tracing = false;
+  traceMissMark = 0;
+  numTraces = 0;
+  if (leafFormat == POSTINGLEAF)
+  {
+    // an encoded rid takes at least two bytes
+    scanKeyBuffer.resize(POSTINGLEAFDATASIZE / 2);
+    scanRidBuffer.resize(POSTINGLEAFDATASIZE / 2);
+    overflowRidBuffer.resize(OVERFLOWDATASIZE / 2);
+  }
+  else if (leafFormat == COMPRESSEDLEAF)
+  {
+    scanKeyBuffer.resize(COMPRESSEDLEAFMAXENTRIES + 1);
+    scanRidBuffer.resize(COMPRESSEDLEAFMAXENTRIES + 1);
+    compressedKeys.resize(COMPRESSEDLEAFMAXENTRIES + 1);
+    compressedRids.resize(COMPRESSEDLEAFMAXENTRIES + 1);
+  }
+  if (leafFormat != SLOTTEDLEAF)
+  {
+    // a compressed leaf has the most keys
+    leafKeyBuffer.resize(COMPRESSEDLEAFMAXENTRIES + 1);
+  }
+
+  suffixCompare = NULL;
+  if (trailingKeyAttrs.size() == 1 && trailingKeyAttrs[0].attrType == INTEGER)
+  {
+    suffixCompare = &compareSuffix<int>;
+  }
+  else if (trailingKeyAttrs.size() == 1 && trailingKeyAttrs[0].attrType == DOUBLE)
+  {
+    suffixCompare = &compareSuffix<double>;
+  }
+  else if (trailingKeyAttrs.size() == 2 && trailingKeyAttrs[0].attrType == INTEGER
+    && trailingKeyAttrs[1].attrType == INTEGER)
+  {
+    suffixCompare = &compareSuffix2<int, int>;
+  }
 
 
   std::ostringstream idxStr;
   idxStr << relationName << "." << attrByteOffset;
+  for (size_t i = 0; i < trailingKeyAttrs.size(); i++)
+  {
+    idxStr << "." << trailingKeyAttrs[i].attrByteOffset;
+  }
+  // indexes on the same key with other INCLUDE attributes or leaf formats get files of their own
+  if (!includeAttrs.empty())
+  {
+    idxStr << ".include";
+    for (size_t i = 0; i < includeAttrs.size(); i++)
+    {
+      idxStr << "." << includeAttrs[i].attrByteOffset;
+    }
+  }
+  if (leafFormat == POSTINGLEAF)
+  {
+    idxStr << ".posting";
+  }
+  else if (leafFormat == COMPRESSEDLEAF)
+  {
+    idxStr << ".compressed";
+  }
   outIndexName = idxStr.str();
 
+  bool badInclude = includeAttrs.size() > (size_t)MAXINCLUDEATTRS || payloadSize > MAXPAYLOADSIZE;
+  for (size_t i = 0; i < includeAttrs.size(); i++)
+  {
+    badInclude = badInclude || getAttrSize(includeAttrs[i]) <= 0;
+  }
+  bool badKey = trailingKeyAttrs.size() > (size_t)MAXTRAILINGKEYATTRS || keySuffixSize > MAXKEYSUFFIXSIZE;
+  for (size_t i = 0; i < trailingKeyAttrs.size(); i++)
+  {
+    badKey = badKey || getAttrSize(trailingKeyAttrs[i]) <= 0;
+  }
+  bool badFormat = leafFormat != SLOTTEDLEAF
+    && ((leafFormat != POSTINGLEAF && leafFormat != COMPRESSEDLEAF) || !includeAttrs.empty() || !trailingKeyAttrs.empty());
+  if (badInclude || badKey || badFormat || insertBufferSize < 0)
+  {
+    throw BadIndexInfoException(outIndexName);
+  }
+
 
   try
   {
@@ -54,16 +631,37 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
     Page *headerPage;
     bufMgr->readPage(file, headerPageNum, headerPage);
     IndexMetaInfo *meta = (IndexMetaInfo *)headerPage;
-    rootPageNum = meta->rootPageNo;
-
 
     if (relationName != meta->relationName || attrType != meta->attrType 
-      || attrByteOffset != meta->attrByteOffset)
+      || attrByteOffset != meta->attrByteOffset || meta->formatVersion != INDEXFORMATVERSION
+      || !isSameAttrs(meta->includeAttrs, meta->numIncludeAttrs, includeAttrs)
+      || !isSameAttrs(meta->trailingKeyAttrs, meta->numTrailingKeyAttrs, trailingKeyAttrs)
+      || meta->leafFormat != leafFormat || meta->bloomFilter != bloomFilter)
     {
+      bufMgr->unPinPage(file, headerPageNum, false);
       throw BadIndexInfoException(outIndexName);
     }
 
+    // everything needed to use the tree is on the meta page, no need to touch the tree itself
+    rootPageNum = meta->rootPageNo;
+    isRootLeaf = meta->rootIsLeaf;
+    height = meta->height;
+    numEntries = meta->numEntries;
+    numLeafPages = meta->numLeafPages;
+    numInternalPages = meta->numInternalPages;
+    minKey = meta->minKey;
+    maxKey = meta->maxKey;
+    firstLeafPageNum = meta->firstLeafPageNo;
+    lastLeafPageNum = meta->lastLeafPageNo;
+    numOverflowPages = meta->numOverflowPages;
+    bloomPageNos.assign(meta->bloomPageNos, meta->bloomPageNos + meta->numBloomPages);
+
     bufMgr->unPinPage(file, headerPageNum, false);    
+
+    if (learnedRouting)
+    {
+      buildLearnedRouting();
+    }
   }
 
  
@@ -87,11 +685,36 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
     meta->attrType = attrType;
     meta->rootPageNo = rootPageNum;
     meta->rootIsLeaf = true;
+    meta->formatVersion = INDEXFORMATVERSION;
+    meta->numIncludeAttrs = includeAttrs.size();
+    for (size_t i = 0; i < includeAttrs.size(); i++)
+    {
+      meta->includeAttrs[i] = includeAttrs[i];
+    }
+    meta->numTrailingKeyAttrs = trailingKeyAttrs.size();
+    for (size_t i = 0; i < trailingKeyAttrs.size(); i++)
+    {
+      meta->trailingKeyAttrs[i] = trailingKeyAttrs[i];
+    }
+    meta->leafFormat = leafFormat;
+    meta->bloomFilter = bloomFilter;
+    meta->numBloomPages = 0;
 
 
     // Store value of our root status to be easily reused
     isRootLeaf = meta->rootIsLeaf;
 
+    // the root starts out as the only leaf
+    height = 1;
+    numEntries = 0;
+    numLeafPages = 1;
+    numInternalPages = 0;
+    minKey = 0;
+    maxKey = 0;
+    firstLeafPageNum = rootPageNum;
+    lastLeafPageNum = rootPageNum;
+    numOverflowPages = 0;
+
 
 
     strncpy((char *)(&(meta->relationName)), relationName.c_str(), 20);
@@ -102,6 +725,16 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
     // initiaize root
     LeafNodeInt *root = (LeafNodeInt *)rootPage;
     root->rightSibPageNo = 0;
+    root->leftSibPageNo = 0;
+    if (leafFormat == POSTINGLEAF)
+    {
+      ((PostingLeafNodeInt *)rootPage)->numKeys = 0;
+      ((PostingLeafNodeInt *)rootPage)->numBytes = 0;
+    }
+    else if (leafFormat == COMPRESSEDLEAF)
+    {
+      encodeCompressedLeaf(NULL, NULL, 0, (CompressedLeafNodeInt *)rootPage);
+    }
 
     bufMgr->unPinPage(file, headerPageNum, true);
     bufMgr->unPinPage(file, rootPageNum, true);
@@ -109,19 +742,32 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
     //fill the newly created Blob File using filescan
     FileScan fileScan(relationName, bufMgr);
     RecordId rid;
+    char key[sizeof(int) + MAXKEYSUFFIXSIZE];
+    char payload[MAXPAYLOADSIZE];
     try
     {
       while(1)
       {
         fileScan.scanNext(rid);
         std::string record = fileScan.getRecord();
-        insertEntry(record.c_str() + attrByteOffset, rid);
+        extractKey(record.c_str(), key);
+        extractPayload(record.c_str(), payload);
+        insertEntry(key, rid, payload);
       }
     }
     catch(EndOfFileException e)
     {
       
-
+      flushInsertBuffer();
+      if (bloomFilter)
+      {
+        buildBloomFilter();
+      }
+      if (learnedRouting)
+      {
+        buildLearnedRouting();
+      }
+      writeMetaInfo();
 
       bufMgr->flushFile(file);
     }
@@ -138,6 +784,10 @@ BTreeIndex::~BTreeIndex()
         endScan(); // cleanup if there is any initialized scan
     }
 
+    flushInsertBuffer();
+    writeMetaInfo();
+    // no reader is left, retired pages go before the file does
+    this->bufMgr->reclaimPages(file);
     this->bufMgr->flushFile(file);
     delete this->file;
     this->file = NULL;
@@ -148,7 +798,7 @@ BTreeIndex::~BTreeIndex()
 
 
 
-void BTreeIndex::formNewRoot(PageId firstPageInRoot, PageKeyPair<int> *newchildEntry)
+void BTreeIndex::formNewRoot(PageId firstPageInRoot, const PageKeyPair<int> &newchildEntry)
 {
   // create a new root 
   PageId newRootPageNum;
@@ -167,69 +817,311 @@ void BTreeIndex::formNewRoot(PageId firstPageInRoot, PageKeyPair<int> *newchildE
 
 
 
-  newRootPage->pageNoArray[0] = firstPageInRoot;
-  newRootPage->pageNoArray[1] = newchildEntry->pageNo;
-  newRootPage->keyArray[0] = newchildEntry->key;
-
-  Page *meta;
-  bufMgr->readPage(file, headerPageNum, meta);
-  IndexMetaInfo *metaPage = (IndexMetaInfo *)meta;
-  metaPage->rootPageNo = newRootPageNum;
-
-  metaPage->rootIsLeaf = false;
+  nodePageNos(newRootPage)[0] = firstPageInRoot;
+  nodePageNos(newRootPage)[1] = newchildEntry.pageNo;
+  newRootPage->keyArray[0] = newchildEntry.key;
+  memcpy(nodeSuffix(newRootPage, 0), newchildEntry.keySuffix, keySuffixSize);
 
   if(isRootLeaf){isRootLeaf = false;}
 
 
   rootPageNum = newRootPageNum;
+  height++;
+  numInternalPages++;
 
-  bufMgr->unPinPage(file, headerPageNum, true);
+  writeMetaInfo();
   bufMgr->unPinPage(file, newRootPageNum, true);
 
 }
 
 
 
-void BTreeIndex::partitionInternalNode(NonLeafNodeInt *oldNode, PageId oldPageNum, PageKeyPair<int> *&newchildEntry)
+void BTreeIndex::writeMetaInfo()
 {
-  // allocate a new nonleaf node
-  PageId newPageNum;
-  Page *newPage;
-  bufMgr->allocPage(file, newPageNum, newPage);
-  NonLeafNodeInt *newNode = (NonLeafNodeInt *)newPage;
+  Page *meta;
+  bufMgr->readPage(file, headerPageNum, meta);
+  IndexMetaInfo *metaPage = (IndexMetaInfo *)meta;
+  metaPage->rootPageNo = rootPageNum;
+  metaPage->rootIsLeaf = isRootLeaf;
+  metaPage->height = height;
+  metaPage->numEntries = numEntries;
+  metaPage->numLeafPages = numLeafPages;
+  metaPage->numInternalPages = numInternalPages;
+  metaPage->minKey = minKey;
+  metaPage->maxKey = maxKey;
+  metaPage->firstLeafPageNo = firstLeafPageNum;
+  metaPage->lastLeafPageNo = lastLeafPageNum;
+  metaPage->numOverflowPages = numOverflowPages;
+  metaPage->numBloomPages = bloomPageNos.size();
+  std::copy(bloomPageNos.begin(), bloomPageNos.end(), metaPage->bloomPageNos);
+  bufMgr->unPinPage(file, headerPageNum, true);
+}
 
-  int mid = nodeOccupancy/2;
-  int pushupIndex = mid;
-  PageKeyPair<int> pushupEntry;
-  if (nodeOccupancy % 2 == 0)
+
+
+std::uint64_t *BTreeIndex::readBloomBlock(std::uint64_t hash, PageId &pageNum)
+{
+  const int blocksPerPage = Page::SIZE / BLOOMBLOCKSIZE;
+  std::uint64_t numBlocks = bloomPageNos.size() * blocksPerPage;
+  // map the high half of the hash onto the blocks without a division
+  std::uint64_t block = ((hash >> 32) * numBlocks) >> 32;
+  pageNum = bloomPageNos[block / blocksPerPage];
+  Page *page;
+  bufMgr->readPage(file, pageNum, page);
+  return (std::uint64_t *)((char *)page + (block % blocksPerPage) * BLOOMBLOCKSIZE);
+}
+
+
+
+void BTreeIndex::addToBloomFilter(int key)
+{
+  std::uint64_t hash = hashKey(key);
+  PageId pageNum;
+  std::uint64_t *block = readBloomBlock(hash, pageNum);
+  unsigned int bit = (unsigned int)hash;
+  unsigned int step = (bit >> 17) | (bit << 15) | 1;
+  for (int i = 0; i < BLOOMNUMPROBES; i++)
+  {
+    unsigned int blockBit = bit % (BLOOMBLOCKSIZE * 8);
+    block[blockBit / 64] |= (std::uint64_t)1 << (blockBit % 64);
+    bit += step;
+  }
+  bufMgr->unPinPage(file, pageNum, true);
+}
+
+
+
+bool BTreeIndex::mayContainKey(const void *key)
+{
+  std::lock_guard<std::recursive_mutex> latch(bufferLatch);
+  if (bloomPageNos.empty())
+  {
+    return true;
+  }
+  std::uint64_t hash = hashKey(*(const int *)key);
+  PageId pageNum;
+  std::uint64_t *block = readBloomBlock(hash, pageNum);
+  unsigned int bit = (unsigned int)hash;
+  unsigned int step = (bit >> 17) | (bit << 15) | 1;
+  bool found = true;
+  for (int i = 0; i < BLOOMNUMPROBES && found; i++)
+  {
+    unsigned int blockBit = bit % (BLOOMBLOCKSIZE * 8);
+    found = (block[blockBit / 64] & ((std::uint64_t)1 << (blockBit % 64))) != 0;
+    bit += step;
+  }
+  bufMgr->unPinPage(file, pageNum, false);
+  return found;
+}
+
+
+
+void BTreeIndex::buildBloomFilter()
+{
+  // the filter is built from the leaves
+  flushInsertBuffer();
+  for (size_t i = 0; i < bloomPageNos.size(); i++)
+  {
+    bufMgr->retirePage(file, bloomPageNos[i]);
+  }
+  bloomPageNos.clear();
+
+  // room for twice the current entries, so that a growing index rebuilds rarely
+  std::uint64_t numBits = std::max(numEntries, (std::uint64_t)1) * 2 * BLOOMBITSPERKEY;
+  std::uint64_t bitsPerPage = Page::SIZE * 8;
+  int numPages = std::min((std::uint64_t)MAXBLOOMPAGES, (numBits + bitsPerPage - 1) / bitsPerPage);
+  for (int i = 0; i < numPages; i++)
+  {
+    PageId pageNum;
+    Page *page;
+    bufMgr->allocPage(file, pageNum, page);
+    memset((char *)page, 0, Page::SIZE);
+    bufMgr->unPinPage(file, pageNum, true);
+    bloomPageNos.push_back(pageNum);
+  }
+
+  // add the keys of every leaf
+  PageId leafPageNum = firstLeafPageNum;
+  while (leafPageNum != 0)
+  {
+    Page *leafPage;
+    bufMgr->readPage(file, leafPageNum, leafPage);
+    int numKeys;
+    const int *keys = getLeafKeys(leafPage, numKeys);
+    for (int i = 0; i < numKeys; i++)
+    {
+      if (i == 0 || keys[i] != keys[i - 1])
+      {
+        addToBloomFilter(keys[i]);
+      }
+    }
+    PageId nextPageNum = ((LeafNodeInt *)leafPage)->rightSibPageNo;
+    bufMgr->unPinPage(file, leafPageNum, false);
+    leafPageNum = nextPageNum;
+  }
+  writeMetaInfo();
+}
+
+
+
+int BTreeIndex::getAttrSize(const AttrDesc &attr)
+{
+  switch (attr.attrType)
+  {
+    case INTEGER:
+      return sizeof(int);
+    case DOUBLE:
+      return sizeof(double);
+    default:
+      return attr.attrLength;
+  }
+}
+
+
+
+void BTreeIndex::extractPayload(const char *record, char *payload)
+{
+  for (size_t i = 0; i < includeAttrs.size(); i++)
   {
-    pushupIndex = newchildEntry->key < oldNode->keyArray[mid] ? mid -1 : mid;
+    int size = getAttrSize(includeAttrs[i]);
+    memcpy(payload, record + includeAttrs[i].attrByteOffset, size);
+    payload += size;
   }
-  pushupEntry.set(newPageNum, oldNode->keyArray[pushupIndex]);
+}
+
+
+
+void BTreeIndex::extractKey(const char *record, char *key)
+{
+  memcpy(key, record + attrByteOffset, sizeof(int));
+  key += sizeof(int);
+  for (size_t i = 0; i < trailingKeyAttrs.size(); i++)
+  {
+    int size = getAttrSize(trailingKeyAttrs[i]);
+    memcpy(key, record + trailingKeyAttrs[i].attrByteOffset, size);
+    key += size;
+  }
+}
 
-  mid = pushupIndex + 1;
-  // move half the entries to the new node
+
+
+bool BTreeIndex::isSameAttrs(const AttrDesc *attrs1, int numAttrs1, const std::vector<AttrDesc> &attrs2)
+{
+  if (numAttrs1 != (int)attrs2.size())
+  {
+    return false;
+  }
+  for (int i = 0; i < numAttrs1; i++)
+  {
+    if (attrs1[i].attrByteOffset != attrs2[i].attrByteOffset || attrs1[i].attrType != attrs2[i].attrType
+      || getAttrSize(attrs1[i]) != getAttrSize(attrs2[i]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
 
 
 
-  for(int i = mid; i < nodeOccupancy; i++)
+int BTreeIndex::compareKeys(int key1, const char *suffix1, int key2, const char *suffix2)
+{
+  if (key1 != key2)
+  {
+    return key1 < key2 ? -1 : 1;
+  }
+  if (keySuffixSize == 0 || suffix1 == NULL || suffix2 == NULL)
   {
-    newNode->keyArray[i-mid] = oldNode->keyArray[i];
-    newNode->pageNoArray[i-mid] = oldNode->pageNoArray[i+1];
-    oldNode->pageNoArray[i+1] = (PageId) 0;
-    oldNode->keyArray[i+1] = 0;
+    return 0;
   }
+  return suffixCompare != NULL ? suffixCompare(suffix1, suffix2) : compareSuffixByAttr(suffix1, suffix2);
+}
 
-  newNode->level = oldNode->level;
 
 
-  oldNode->keyArray[pushupIndex] = 0;
-  oldNode->pageNoArray[pushupIndex] = (PageId) 0;
+int BTreeIndex::compareSuffixByAttr(const char *suffix1, const char *suffix2)
+{
+  for (size_t i = 0; i < trailingKeyAttrs.size(); i++)
+  {
+    int cmp;
+    switch (trailingKeyAttrs[i].attrType)
+    {
+      case INTEGER:
+        cmp = compareSuffix<int>(suffix1, suffix2);
+        break;
+      case DOUBLE:
+        cmp = compareSuffix<double>(suffix1, suffix2);
+        break;
+      default:
+        cmp = strncmp(suffix1, suffix2, trailingKeyAttrs[i].attrLength);
+        break;
+    }
+    if (cmp != 0)
+    {
+      return cmp;
+    }
+    int size = getAttrSize(trailingKeyAttrs[i]);
+    suffix1 += size;
+    suffix2 += size;
+  }
+  return 0;
+}
+
 
-  insertInternalNode(newchildEntry->key < newNode->keyArray[0] ? oldNode : newNode, newchildEntry);
 
+void BTreeIndex::partitionInternalNode(NonLeafNodeInt *oldNode, PageId oldPageNum, PageId splitChildNum, PageKeyPair<int> &newchildEntry)
+{
+  // allocate a new nonleaf node
+  PageId newPageNum;
+  Page *newPage;
+  bufMgr->allocPage(file, newPageNum, newPage);
+  NonLeafNodeInt *newNode = (NonLeafNodeInt *)newPage;
+  numInternalPages++;
+  counters.splitsByLevel[oldNode->level]++;
+  TRACESPLIT();
+
+  // line up all the separators and children in order, the new entry right after the child it was split from
+  int keys[INTARRAYNONLEAFSIZE + 1];
+  PageId pageNos[INTARRAYNONLEAFSIZE + 2];
+  char suffixes[Page::SIZE + MAXKEYSUFFIXSIZE];
+  PageId *oldPageNos = nodePageNos(oldNode);
+  int numKeys = 0;
+  pageNos[0] = oldPageNos[0];
+  for(int i = 0; i <= nodeOccupancy; i++)
+  {
+    if (oldPageNos[i] == splitChildNum)
+    {
+      keys[numKeys] = newchildEntry.key;
+      memcpy(suffixes + numKeys * keySuffixSize, newchildEntry.keySuffix, keySuffixSize);
+      pageNos[numKeys + 1] = newchildEntry.pageNo;
+      numKeys++;
+    }
+    if (i < nodeOccupancy)
+    {
+      keys[numKeys] = oldNode->keyArray[i];
+      memcpy(suffixes + numKeys * keySuffixSize, nodeSuffix(oldNode, i), keySuffixSize);
+      pageNos[numKeys + 1] = oldPageNos[i + 1];
+      numKeys++;
+    }
+  }
 
-  newchildEntry = &pushupEntry;
+  // the middle separator moves up, the ones right of it go to the new node
+  int mid = numKeys / 2;
+
+  int level = oldNode->level;
+  memset(oldNode, 0, Page::SIZE);
+  oldNode->level = level;
+  newNode->level = level;
+  memcpy(oldNode->keyArray, keys, mid * sizeof(int));
+  memcpy(nodePageNos(oldNode), pageNos, (mid + 1) * sizeof(PageId));
+  memcpy(nodeSuffix(oldNode, 0), suffixes, mid * keySuffixSize);
+  memcpy(newNode->keyArray, &keys[mid + 1], (numKeys - mid - 1) * sizeof(int));
+  memcpy(nodePageNos(newNode), &pageNos[mid + 1], (numKeys - mid) * sizeof(PageId));
+  memcpy(nodeSuffix(newNode, 0), suffixes + (mid + 1) * keySuffixSize, (numKeys - mid - 1) * keySuffixSize);
+
+  // the entry passed up replaces the one that came from the child, which is in the arrays now
+  newchildEntry.set(newPageNum, keys[mid]);
+  memcpy(newchildEntry.keySuffix, suffixes + mid * keySuffixSize, keySuffixSize);
   bufMgr->unPinPage(file, oldPageNum, true);
   bufMgr->unPinPage(file, newPageNum, true);
 
@@ -242,48 +1134,50 @@ void BTreeIndex::partitionInternalNode(NonLeafNodeInt *oldNode, PageId oldPageNu
 
 
 
-void BTreeIndex::partitionLeaf(LeafNodeInt *leaf, PageId leafPageNum, PageKeyPair<int> *&newchildEntry, const RIDKeyPair<int> dataEntry)
+void BTreeIndex::partitionLeaf(LeafNodeInt *leaf, PageId leafPageNum, PageKeyPair<int> &newchildEntry, const RIDKeyPair<int> dataEntry, const char *suffixAndPayload)
 {
   // allocate a new leaf page
   PageId newPageNum;
   Page *newPage;
   bufMgr->allocPage(file, newPageNum, newPage);
   LeafNodeInt *newLeafNode = (LeafNodeInt *)newPage;
+  numLeafPages++;
 
   int mid = leafOccupancy/2;
 
 
-  if (leafOccupancy %2 == 1 && dataEntry.key > leaf->keyArray[mid])
+  if (leaf->rightSibPageNo == 0 && compareKeys(dataEntry.key, suffixAndPayload, leaf->keyArray[leafOccupancy - 1], leafSuffix(leaf, leafOccupancy - 1)) >= 0)
   {
-    mid = mid + 1;
+    // appending past the largest key, as ascending keys do: the left leaf will not get more entries
+    mid = leafOccupancy * APPENDSPLITPERCENT / 100;
   }
-  // copy half the page to newLeafNode
-  for(int i = mid; i < leafOccupancy; i++)
+  else if (leafOccupancy %2 == 1 && compareKeys(dataEntry.key, suffixAndPayload, leaf->keyArray[mid], leafSuffix(leaf, mid)) > 0)
   {
-    newLeafNode->keyArray[i-mid] = leaf->keyArray[i];
-    newLeafNode->ridArray[i-mid] = leaf->ridArray[i];
-    leaf->keyArray[i] = 0;
-    leaf->ridArray[i].page_number = 0;
+    mid = mid + 1;
   }
+  // move half the page to newLeafNode
+  int numMoved = leafOccupancy - mid;
+  memcpy(newLeafNode->keyArray, &leaf->keyArray[mid], numMoved * sizeof(int));
+  memcpy(leafRids(newLeafNode), &leafRids(leaf)[mid], numMoved * sizeof(RecordId));
+  memcpy(leafSuffix(newLeafNode, 0), leafSuffix(leaf, mid), numMoved * (keySuffixSize + payloadSize));
+  memset(&leaf->keyArray[mid], 0, numMoved * sizeof(int));
+  memset(&leafRids(leaf)[mid], 0, numMoved * sizeof(RecordId));
+  memset(leafSuffix(leaf, mid), 0, numMoved * (keySuffixSize + payloadSize));
   
-  if (dataEntry.key > leaf->keyArray[mid-1])
+  if (compareKeys(dataEntry.key, suffixAndPayload, leaf->keyArray[mid-1], leafSuffix(leaf, mid-1)) > 0)
   {
-    insertLeafNode(newLeafNode, dataEntry);
+    insertLeafNode(newLeafNode, dataEntry, suffixAndPayload);
   }
   else
   {
-    insertLeafNode(leaf, dataEntry);
+    insertLeafNode(leaf, dataEntry, suffixAndPayload);
   }
 
-  // update sibling pointer
-  newLeafNode->rightSibPageNo = leaf->rightSibPageNo;
-  leaf->rightSibPageNo = newPageNum;
+  linkNewLeaf(leaf, leafPageNum, newLeafNode, newPageNum, newLeafNode->keyArray[0]);
 
   // the smallest key from second page as the new child entry
-  newchildEntry = new PageKeyPair<int>();
-  PageKeyPair<int> newKeyPair;
-  newKeyPair.set(newPageNum, newLeafNode->keyArray[0]);
-  newchildEntry = &newKeyPair;
+  newchildEntry.set(newPageNum, newLeafNode->keyArray[0]);
+  memcpy(newchildEntry.keySuffix, leafSuffix(newLeafNode, 0), keySuffixSize);
   bufMgr->unPinPage(file, leafPageNum, true);
   bufMgr->unPinPage(file, newPageNum, true);
 
@@ -295,308 +1189,2004 @@ void BTreeIndex::partitionLeaf(LeafNodeInt *leaf, PageId leafPageNum, PageKeyPai
 }
 
 
-void BTreeIndex::searchLevel(NonLeafNodeInt *curNode, PageId &nextNodeNum, int key)
+void BTreeIndex::linkNewLeaf(LeafNodeInt *leaf, PageId leafPageNum, LeafNodeInt *newLeaf, PageId newPageNum, int newFirstKey)
 {
-  int i = nodeOccupancy;
-  while(i >= 0 && (curNode->pageNoArray[i] == 0))
+  counters.splitsByLevel[0]++;
+  TRACESPLIT();
+  // update sibling pointers, the old right sibling now has the new leaf on its left
+  newLeaf->rightSibPageNo = leaf->rightSibPageNo;
+  newLeaf->leftSibPageNo = leafPageNum;
+  leaf->rightSibPageNo = newPageNum;
+  if (newLeaf->rightSibPageNo == 0)
   {
-    i--;
+    lastLeafPageNum = newPageNum;
   }
-  while(i > 0 && (curNode->keyArray[i-1] >= key))
+  else
   {
-    i--;
+    Page *rightPage;
+    bufMgr->readPage(file, newLeaf->rightSibPageNo, rightPage);
+    ((LeafNodeInt *)rightPage)->leftSibPageNo = newPageNum;
+    bufMgr->unPinPage(file, newLeaf->rightSibPageNo, true);
+  }
+  if (!learnedSegments.empty())
+  {
+    addLearnedFence(leafPageNum, newPageNum, newFirstKey);
   }
-  nextNodeNum = curNode->pageNoArray[i];
+  recordLeafOrigin(newPageNum, leafPageNum);
 }
 
 
 
-void BTreeIndex::insertLeafNode(LeafNodeInt *leaf, RIDKeyPair<int> entry)
+void BTreeIndex::buildLearnedRouting()
 {
-  // empty leaf page
-  if (leaf->ridArray[0].page_number == 0)
+  fenceKeys.clear();
+  fencePageNos.clear();
+  learnedSegments.clear();
+  if (numEntries == 0)
+  {
+    // an empty root leaf has no key to fence it, lookups descend until the index is reopened
+    return;
+  }
+  // nothing is routed below the first leaf, the smallest key keeps the models from stretching to INT_MIN
+  if (isRootLeaf)
   {
-    leaf->keyArray[0] = entry.key;
-    leaf->ridArray[0] = entry.rid;    
+    fenceKeys.push_back(minKey);
+    fencePageNos.push_back(rootPageNum);
   }
   else
   {
-    int i = leafOccupancy - 1;
-    // find the end
-    while(i >= 0 && (leaf->ridArray[i].page_number == 0))
-    {
-      i--;
-    }
-    // shift entry
-    while(i >= 0 && (leaf->keyArray[i] > entry.key))
-    {
-      leaf->keyArray[i+1] = leaf->keyArray[i];
-      leaf->ridArray[i+1] = leaf->ridArray[i];
-      i--;
-    }
-    // insert entry
-    leaf->keyArray[i+1] = entry.key;
-    leaf->ridArray[i+1] = entry.rid;
+    collectFences(rootPageNum, minKey);
   }
+  trainSegments(0, fenceKeys.size(), learnedSegments);
 }
 
-void BTreeIndex::insertInternalNode(NonLeafNodeInt *nonleaf, PageKeyPair<int> *entry)
+
+
+void BTreeIndex::collectFences(PageId pageNum, int lowKey)
 {
-  
-  int i = nodeOccupancy;
-  while(i >= 0 && (nonleaf->pageNoArray[i] == 0))
+  Page *page;
+  bufMgr->readPage(file, pageNum, page);
+  NonLeafNodeInt *node = (NonLeafNodeInt *)page;
+  PageId *pageNoArray = nodePageNos(node);
+  for (int i = 0; i <= nodeOccupancy && pageNoArray[i] != 0; i++)
   {
-    i--;
-  }
-  while( i > 0 && (nonleaf->keyArray[i-1] > entry->key))
-  {
-    nonleaf->keyArray[i] = nonleaf->keyArray[i-1];
-    nonleaf->pageNoArray[i+1] = nonleaf->pageNoArray[i];
-    i--;
+    int childLowKey = i == 0 ? lowKey : node->keyArray[i - 1];
+    if (node->level == 1)
+    {
+      fenceKeys.push_back(childLowKey);
+      fencePageNos.push_back(pageNoArray[i]);
+    }
+    else
+    {
+      collectFences(pageNoArray[i], childLowKey);
+    }
   }
-
-  nonleaf->keyArray[i] = entry->key;
-  nonleaf->pageNoArray[i+1] = entry->pageNo;
+  bufMgr->unPinPage(file, pageNum, false);
 }
 
 
 
-
-void BTreeIndex::insertHelper(Page *curPage, PageId curPageNum, bool nodeIsLeaf, const RIDKeyPair<int> dataEntry, PageKeyPair<int> *&newchildEntry)
+void BTreeIndex::trainSegments(int first, int num, std::vector<LearnedSegment> &segments)
 {
-
-  // nonleaf node
-
-  if (nodeIsLeaf)
+  int end = first + num;
+  while (first < end)
   {
-    
-    LeafNodeInt *leaf = (LeafNodeInt *)curPage;
-    if (leaf->ridArray[leafOccupancy - 1].page_number == 0) {
-      insertLeafNode(leaf, dataEntry);
-      bufMgr->unPinPage(file, curPageNum, true);
-      newchildEntry = nullptr;
-    } else{
-      partitionLeaf(leaf, curPageNum, newchildEntry, dataEntry);
-    }
-  }
-  else {
-   NonLeafNodeInt *curNode = (NonLeafNodeInt *)curPage;
-    // find the right key to traverse
-    Page *nextPage;
-    PageId nextNodeNum;
-    searchLevel(curNode, nextNodeNum, dataEntry.key);
-    bufMgr->readPage(file, nextNodeNum, nextPage);
-    // NonLeafNodeInt *nextNode = (NonLeafNodeInt *)nextPage;
-    nodeIsLeaf = curNode->level == 1;
-    insertHelper(nextPage, nextNodeNum, nodeIsLeaf, dataEntry, newchildEntry);
-    
-    // no split in child, just return
-    if (newchildEntry == nullptr)
+    // shrink the cone of slopes that keep every fence so far within the error bound
+    LearnedSegment segment;
+    segment.firstKey = fenceKeys[first];
+    segment.firstFence = first;
+    double slopeLow = 0;
+    double slopeHigh = 1e300;
+    int next = first + 1;
+    for (; next < end; next++)
     {
-        // unpin current page from call stack
-        bufMgr->unPinPage(file, curPageNum, false);
-    }
-    else
-      { 
-      if (curNode->pageNoArray[nodeOccupancy] == 0)
+      double dx = (double)fenceKeys[next] - fenceKeys[first];
+      double dy = next - first;
+      if (dx == 0)
       {
-        insertInternalNode(curNode, newchildEntry);
-        newchildEntry = nullptr;
-        bufMgr->unPinPage(file, curPageNum, true);
+        if (dy > LEARNEDERRORBOUND)
+        {
+          break;
+        }
+        continue;
       }
-      else
+      double low = std::max(slopeLow, (dy - LEARNEDERRORBOUND) / dx);
+      double high = std::min(slopeHigh, (dy + LEARNEDERRORBOUND) / dx);
+      if (low > high)
       {
-        partitionInternalNode(curNode, curPageNum, newchildEntry);
+        break;
       }
+      slopeLow = low;
+      slopeHigh = high;
     }
+    segment.numFences = next - first;
+    segment.slope = slopeHigh == 1e300 ? 0 : (slopeLow + slopeHigh) / 2;
+    segments.push_back(segment);
+    first = next;
   }
 }
 
 
-void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
+
+void BTreeIndex::addLearnedFence(PageId leafPageNum, PageId newPageNum, int newFirstKey)
 {
-  RIDKeyPair<int> dataEntry;
-  dataEntry.set(rid, *((int *)key));
-  // root
-  Page* root;
-  // PageId rootPageNum;
-  bufMgr->readPage(file, rootPageNum, root);
-  PageKeyPair<int> *newchildEntry = nullptr;
-
-
-  insertHelper(root, rootPageNum, isRootLeaf, dataEntry, newchildEntry);
-}
-
-
-
-
-
-void BTreeIndex::findLeaf()//need to implement with new knowledge of how key array and pageNoArray work, if i = 0 for key and lowOP < key then pageNoArray = 0, otherwise if lowOP > key[i], < key[i+1] then 
-{
-    bufMgr->readPage(this->file, this->rootPageNum, this->currentPageData); //Pins the Current Page
-    this->currentPageNum = this->rootPageNum;
-    NonLeafNodeInt* current = (NonLeafNodeInt*)(currentPageData);
-    int prevLevel = current->level;
-    do{ //Repeats this until it gets a page with a level 1, then it does it one more time to find the leaf node
-        for(int i = 0; i < sizeof(current->keyArray); i++){
-            if(lowOp == GT){ //comparing for the 4 different cases of GT:LT, GTE:LT, GT:LTE, GTE:LTE
-                if(lowValInt < current->keyArray[i]){ //Checking that the low value is less than the key at that index which will corrospond to the index of the page no with that key
-                    int prevPageNum = currentPageNum;
-                    currentPageNum = current->pageNoArray[i];
-                    bufMgr->readPage(this->file, currentPageNum, currentPageData); //Gets a new page and pins it
-                    prevLevel = current->level;
-                    bufMgr->unPinPage(this->file, prevPageNum, false); //Unpins the previous current page
-                    current = (NonLeafNodeInt*)(currentPageData);
-                    break;
-                }
-                if(current->keyArray[i] == 0 && i > 1 && lowValInt > current->keyArray[i]){ //Checks to see if we reached the end of the array by checking for a 0 in a spot after 0 in the array
-                    bufMgr->unPinPage(this->file, currentPageNum, false);
-                    throw NoSuchKeyFoundException();
-                }
-            }
-            if(lowOp == GTE){
-                if(lowValInt <= current->keyArray[i]){//see the comment on like 441 for details
-                    int prevPageNum = currentPageNum;
-                    currentPageNum = current->pageNoArray[i];
-                    bufMgr->readPage(this->file, currentPageNum, currentPageData); //gets a new page and pins it
-                    prevLevel = current->level;
-                    bufMgr->unPinPage(this->file, prevPageNum, false);//unpins previous page
-                    current = (NonLeafNodeInt*)(currentPageData);
-                    break;
-                }
-                if(current->keyArray[i] == 0 && i > 1 && lowValInt > current->keyArray[i]){ //See 450
-                    bufMgr->unPinPage(this->file, currentPageNum, false);
-                    throw NoSuchKeyFoundException();
-                }
-            }
-        
-        }
-    }
-    while(prevLevel != 1);
-    for(int i = 0; i < sizeof(current->keyArray); i++){ //Gets the appropriate nextEntry Value based on ops
-      if(lowOp == GT){
-        if(highOp == LT){
-          if(current->keyArray[i] > lowValInt && current->keyArray[i] < highValInt){
-            nextEntry = i;
-            break;
-          }
-        }
-        if(highOp == LTE){
-          if(current->keyArray[i] > lowValInt && current->keyArray[i] <= highValInt){
-            nextEntry = i;
-            break;
-          }
-        } 
-      }
-      if(lowOp == GTE){
-        if(highOp == LT){
-          if(current->keyArray[i] >= lowValInt && current->keyArray[i] < highValInt){
-            nextEntry = i;
-            break;
-          }
-        }
-        if(highOp == LTE){
-          if(current->keyArray[i] >= lowValInt && current->keyArray[i] <= highValInt){
-            nextEntry = i;
-            break;
-        }
-      }
-    }
+  // the split leaf is the last one fenced at or below the new key, or close before it with duplicates
+  int pos = std::upper_bound(fenceKeys.begin(), fenceKeys.end(), newFirstKey) - fenceKeys.begin() - 1;
+  pos = std::max(pos, 0);
+  while (pos >= 0 && fencePageNos[pos] != leafPageNum)
+  {
+    pos--;
   }
-  
+  if (pos < 0)
+  {
+    // fences out of step with the leaves, start over
+    buildLearnedRouting();
+    return;
+  }
+  // the first leaf is fenced by the smallest key at build time, smaller keys may have come since
+  fenceKeys[0] = std::min(fenceKeys[0], newFirstKey);
+  fenceKeys.insert(fenceKeys.begin() + pos + 1, newFirstKey);
+  fencePageNos.insert(fencePageNos.begin() + pos + 1, newPageNum);
+
+  // only the segment holding the split leaf is retrained, the ones after it just move up a position
+  int seg = 0;
+  while (seg + 1 < (int)learnedSegments.size() && learnedSegments[seg + 1].firstFence <= pos)
+  {
+    seg++;
+  }
+  for (size_t i = seg + 1; i < learnedSegments.size(); i++)
+  {
+    learnedSegments[i].firstFence++;
+  }
+  std::vector<LearnedSegment> retrained;
+  trainSegments(learnedSegments[seg].firstFence, learnedSegments[seg].numFences + 1, retrained);
+  learnedSegments.erase(learnedSegments.begin() + seg);
+  learnedSegments.insert(learnedSegments.begin() + seg, retrained.begin(), retrained.end());
 }
 
 
-void BTreeIndex::startScan(const void* lowValParm,
-           const Operator lowOpParm,
-           const void* highValParm,
-           const Operator highOpParm)
+
+bool BTreeIndex::predictLeaf(int key, PageId &leafPageNum)
 {
-  this->lowOp = lowOpParm;
-  this->highOp = highOpParm;
-  if(lowOp != GT){ //Checking the opcodes
-    if(lowOp != GTE){
-      throw BadOpcodesException();
-    }
+  // a lookup starts at the last leaf fenced below the key; nothing is below the first leaf
+  if (key <= fenceKeys[0])
+  {
+    leafPageNum = fencePageNos[0];
+    return true;
   }
-  if(highOp != LT){
-    if(highOp != LTE){
-      throw BadOpcodesException();
+  int seg = 0;
+  int low = 1;
+  int high = learnedSegments.size() - 1;
+  while (low <= high)
+  {
+    int midSeg = (low + high) / 2;
+    if (learnedSegments[midSeg].firstKey < key)
+    {
+      seg = midSeg;
+      low = midSeg + 1;
+    }
+    else
+    {
+      high = midSeg - 1;
     }
   }
-  this->lowValInt = *(int*)(lowValParm);
-  this->highValInt = *(int*)(highValParm);
-
-  
-  if(this->highValInt < this->lowValInt){ //Checking that the bounds are correct
-    throw BadScanrangeException();
-  }
-  if(scanExecuting == true){ //Checks for an Existing Scan
-    endScan();
+  const LearnedSegment &segment = learnedSegments[seg];
+  int segmentEnd = segment.firstFence + segment.numFences;
+  double predicted = segment.firstFence + ((double)key - segment.firstKey) * segment.slope;
+  // keys past the last fence of the segment belong to its last leaves
+  predicted = std::min(predicted, (double)segmentEnd - 1);
+  int from = std::max((double)segment.firstFence, predicted - LEARNEDERRORBOUND - 1);
+  int to = std::min((double)segmentEnd, predicted + LEARNEDERRORBOUND + 2);
+  if (from >= to || fenceKeys[from] >= key || (to < segmentEnd && fenceKeys[to] < key))
+  {
+    return false;
   }
-  scanExecuting = true; //Sets there to be a scan going
-  findLeaf();//finds the leaf
-  
+  int pos = std::lower_bound(fenceKeys.begin() + from, fenceKeys.begin() + to, key) - fenceKeys.begin() - 1;
+  leafPageNum = fencePageNos[pos];
+  return true;
 }
 
 
-void BTreeIndex::scanNext(RecordId& outRid) 
+
+void BTreeIndex::routeToLeaf(int key, PageId &leafPageNum, Page *&leafPage)
 {
- if(!scanExecuting){ //Checking that scan has been initialized
-    throw ScanNotInitializedException();
+  if (!learnedSegments.empty() && predictLeaf(key, leafPageNum))
+  {
+    bufMgr->readPage(file, leafPageNum, leafPage);
+    TRACEPAGE(leafPageNum, 0);
+    return;
   }
-  LeafNodeInt* currentPage = (LeafNodeInt*)(currentPageData); //gets a usuable version of the current page
-    if(lowOp == GT){
-    while(currentPage->keyArray[nextEntry] <= lowValInt){//verifies that the nextEntry is correct
-      nextEntry++;
+  descendToLeaf(key, leafPageNum, leafPage);
+}
+
+
+
+void BTreeIndex::insertPostingLeaf(PostingLeafNodeInt *leaf, PageId leafPageNum, const RIDKeyPair<int> dataEntry, PageKeyPair<int> &newchildEntry)
+{
+  // find the posting list of the key, or the place for a new one
+  char *start = leaf->data;
+  char *end = leaf->data + leaf->numBytes;
+  PostingList list;
+  bool found = false;
+  while (start < end)
+  {
+    readPostingList(start, list);
+    if (list.key >= dataEntry.key)
+    {
+      found = list.key == dataEntry.key;
+      break;
     }
+    start = (char *)list.end;
   }
-  if(lowOp == GTE){//verifies that the nextEntry is correct
-    while(currentPage->keyArray[nextEntry] < lowValInt){
-      nextEntry++;
-    }
+  char *oldEnd = found ? (char *)list.end : start;
+
+  // build the new version of the list
+  char ridBytes[POSTINGINLINELIMIT + 32];
+  if (!found)
+  {
+    list.key = dataEntry.key;
+    list.numRids = 1;
+    list.overflow = false;
+    list.numRidBytes = encodeRids(&dataEntry.rid, 1, ridBytes);
+    list.rids = ridBytes;
   }
-  if(highOp == LT){
-    if(currentPage->keyArray[nextEntry] < highValInt){//gets the rid of the nextEntry based on the Ops
-      outRid = currentPage->ridArray[nextEntry];
-    }
-    else{
-      throw IndexScanCompletedException();//assuming a sorted node finishes throws exception when reaches a node that is larger than the highOP
-    }
+  else if (list.overflow)
+  {
+    insertOverflowRid(list.tailPageNo, dataEntry.rid);
+    list.numRids++;
   }
-  if(highOp == LTE){
-    if(currentPage->keyArray[nextEntry] <= highValInt){
-      outRid = currentPage->ridArray[nextEntry];
-    }
-    else{
-      throw IndexScanCompletedException();
+  else
+  {
+    postingRids.resize(list.numRids + 1);
+    RecordId *rids = &postingRids[0];
+    decodeRids(list.rids, list.numRids, rids);
+    int pos = std::upper_bound(rids, rids + list.numRids, dataEntry.rid, ridLess) - rids;
+    memmove(&rids[pos + 1], &rids[pos], (list.numRids - pos) * sizeof(RecordId));
+    rids[pos] = dataEntry.rid;
+    list.numRids++;
+    list.numRidBytes = encodeRids(rids, list.numRids, ridBytes);
+    list.rids = ridBytes;
+    if (list.numRidBytes > POSTINGINLINELIMIT)
+    {
+      // the list got long, only its overflow pages stay in the leaf
+      list.overflow = true;
+      list.headPageNo = createOverflowList(rids, list.numRids);
+      list.tailPageNo = list.headPageNo;
     }
   }
-  if(nextEntry > 0 && (currentPage->keyArray[nextEntry+1] == 0 && currentPage->keyArray[nextEntry + 2] == 0)){ //after getting the rid now get next entry, if this statement is true then we need to move to the next leaf node
-    nextEntry = 0;
-    int prevPageNum = currentPageNum;
-    currentPageNum = currentPage->rightSibPageNo;
-    bufMgr->readPage(file, currentPage->rightSibPageNo, currentPageData); //pins a new current page
-    bufMgr->unPinPage(this->file, prevPageNum, true); //unpins the previous current page
-    
+  char newList[POSTINGINLINELIMIT + 64];
+  int newLength = writePostingList(newList, list);
+  int numBytes = leaf->numBytes - (oldEnd - start) + newLength;
+  int numKeys = leaf->numKeys + (found ? 0 : 1);
+
+  if (numBytes <= POSTINGLEAFDATASIZE)
+  {
+    memmove(start + newLength, oldEnd, end - oldEnd);
+    memcpy(start, newList, newLength);
+    leaf->numBytes = numBytes;
+    leaf->numKeys = numKeys;
+    bufMgr->unPinPage(file, leafPageNum, true);
+    newchildEntry.pageNo = 0;
+    return;
+  }
+
+  // no room, lay out all the lists and split at the list boundary closest to the middle
+  char lists[POSTINGLEAFDATASIZE + POSTINGINLINELIMIT + 64];
+  int numBefore = start - leaf->data;
+  memcpy(lists, leaf->data, numBefore);
+  memcpy(lists + numBefore, newList, newLength);
+  memcpy(lists + numBefore + newLength, oldEnd, end - oldEnd);
+  int half = numBytes / 2;
+  int splitBytes = 0;
+  int splitKeys = 0;
+  while (true)
+  {
+    readPostingList(lists + splitBytes, list);
+    int listEnd = list.end - lists;
+    if (listEnd == numBytes || (splitKeys > 0 && listEnd - half > half - splitBytes))
+    {
+      break;
+    }
+    splitBytes = listEnd;
+    splitKeys++;
   }
-  else{
-    nextEntry++; //did not need to go to a new node
+
+  // allocate a new leaf page for the lists right of the split
+  PageId newPageNum;
+  Page *newPage;
+  bufMgr->allocPage(file, newPageNum, newPage);
+  PostingLeafNodeInt *newLeafNode = (PostingLeafNodeInt *)newPage;
+  numLeafPages++;
+
+  memcpy(leaf->data, lists, splitBytes);
+  leaf->numBytes = splitBytes;
+  leaf->numKeys = splitKeys;
+  memcpy(newLeafNode->data, lists + splitBytes, numBytes - splitBytes);
+  newLeafNode->numBytes = numBytes - splitBytes;
+  newLeafNode->numKeys = numKeys - splitKeys;
+  readPostingList(newLeafNode->data, list);
+  linkNewLeaf((LeafNodeInt *)leaf, leafPageNum, (LeafNodeInt *)newLeafNode, newPageNum, list.key);
+
+  // the first key of the new leaf as the new child entry
+  newchildEntry.set(newPageNum, list.key);
+  bufMgr->unPinPage(file, leafPageNum, true);
+  bufMgr->unPinPage(file, newPageNum, true);
+
+  // if curr page is root
+  if (leafPageNum == rootPageNum)
+  {
+    formNewRoot(leafPageNum, newchildEntry);
   }
 }
 
 
-void BTreeIndex::endScan() 
+
+void BTreeIndex::insertCompressedLeaf(CompressedLeafNodeInt *leaf, PageId leafPageNum, const RIDKeyPair<int> dataEntry, PageKeyPair<int> &newchildEntry)
 {
-  if(!scanExecuting){ //checks that a scan is executing
-    throw ScanNotInitializedException();
-    scanExecuting = false;
+  int *keys = &compressedKeys[0];
+  RecordId *rids = &compressedRids[0];
+  int numEntries = leaf->numEntries;
+  decodeCompressedLeaf(leaf, keys, rids);
+
+  // insert after any entries with the same key
+  int pos = std::upper_bound(keys, keys + numEntries, dataEntry.key) - keys;
+  memmove(&keys[pos + 1], &keys[pos], (numEntries - pos) * sizeof(int));
+  memmove(&rids[pos + 1], &rids[pos], (numEntries - pos) * sizeof(RecordId));
+  keys[pos] = dataEntry.key;
+  rids[pos] = dataEntry.rid;
+  numEntries++;
+
+  if (numEntries <= COMPRESSEDLEAFMAXENTRIES && encodeCompressedLeaf(keys, rids, numEntries, leaf))
+  {
+    bufMgr->unPinPage(file, leafPageNum, true);
+    newchildEntry.pageNo = 0;
     return;
   }
-  bufMgr->unPinPage(file, currentPageNum, true); //unpins the only pinned paged which is the current page
-  scanExecuting = false;//sets scan executing to false
+
+  // split in the middle, each half fits whatever widths it needs; a prefix of the old entries always fits
+  PageId newPageNum;
+  Page *newPage;
+  bufMgr->allocPage(file, newPageNum, newPage);
+  CompressedLeafNodeInt *newLeafNode = (CompressedLeafNodeInt *)newPage;
+  numLeafPages++;
+
+  int mid = numEntries / 2;
+  if (leaf->rightSibPageNo == 0 && pos == numEntries - 1)
+  {
+    // appending past the largest key, as ascending keys do: the left leaf will not get more entries
+    mid = numEntries * APPENDSPLITPERCENT / 100;
+  }
+  encodeCompressedLeaf(keys, rids, mid, leaf);
+  encodeCompressedLeaf(keys + mid, rids + mid, numEntries - mid, newLeafNode);
+  linkNewLeaf((LeafNodeInt *)leaf, leafPageNum, (LeafNodeInt *)newLeafNode, newPageNum, keys[mid]);
+
+  // the smallest key from second page as the new child entry
+  newchildEntry.set(newPageNum, keys[mid]);
+  bufMgr->unPinPage(file, leafPageNum, true);
+  bufMgr->unPinPage(file, newPageNum, true);
+
+  // if curr page is root
+  if (leafPageNum == rootPageNum)
+  {
+    formNewRoot(leafPageNum, newchildEntry);
+  }
+}
 
 
+
+void BTreeIndex::insertOverflowRid(PageId &tailPageNo, RecordId rid)
+{
+  // rids mostly arrive in ascending order, so start at the last page and walk back to the one the rid falls in
+  PageId pageNum = tailPageNo;
+  Page *page;
+  bufMgr->readPage(file, pageNum, page);
+  PostingOverflowNode *node = (PostingOverflowNode *)page;
+  RecordId firstRid;
+  decodeRids(node->data, 1, &firstRid);
+  while (node->prevPageNo != 0 && ridLess(rid, firstRid))
+  {
+    PageId prevPageNum = node->prevPageNo;
+    bufMgr->readPage(file, prevPageNum, page);
+    bufMgr->unPinPage(file, pageNum, false);
+    pageNum = prevPageNum;
+    node = (PostingOverflowNode *)page;
+    decodeRids(node->data, 1, &firstRid);
+  }
+
+  int numRids = node->numRids;
+  postingRids.resize(numRids + 1);
+  RecordId *rids = &postingRids[0];
+  decodeRids(node->data, numRids, rids);
+  int pos = std::upper_bound(rids, rids + numRids, rid, ridLess) - rids;
+  memmove(&rids[pos + 1], &rids[pos], (numRids - pos) * sizeof(RecordId));
+  rids[pos] = rid;
+  numRids++;
+
+  char encoded[OVERFLOWDATASIZE + 32];
+  int numBytes = encodeRids(rids, numRids, encoded);
+  if (numBytes <= OVERFLOWDATASIZE)
+  {
+    memcpy(node->data, encoded, numBytes);
+    node->numRids = numRids;
+    node->numBytes = numBytes;
+    bufMgr->unPinPage(file, pageNum, true);
+    return;
+  }
+
+  // split the page. A rid appended to the end of the list starts a new last page, so that loading
+  // in rid order leaves full pages behind
+  int numLeft = (pos == numRids - 1 && node->nextPageNo == 0) ? numRids - 1 : numRids / 2;
+  PageId newPageNum;
+  Page *newPage;
+  bufMgr->allocPage(file, newPageNum, newPage);
+  PostingOverflowNode *newNode = (PostingOverflowNode *)newPage;
+  numOverflowPages++;
+
+  node->numRids = numLeft;
+  node->numBytes = encodeRids(rids, numLeft, node->data);
+  newNode->numRids = numRids - numLeft;
+  newNode->numBytes = encodeRids(rids + numLeft, numRids - numLeft, newNode->data);
+  newNode->prevPageNo = pageNum;
+  newNode->nextPageNo = node->nextPageNo;
+  if (node->nextPageNo == 0)
+  {
+    tailPageNo = newPageNum;
+  }
+  else
+  {
+    Page *nextPage;
+    bufMgr->readPage(file, node->nextPageNo, nextPage);
+    ((PostingOverflowNode *)nextPage)->prevPageNo = newPageNum;
+    bufMgr->unPinPage(file, node->nextPageNo, true);
+  }
+  node->nextPageNo = newPageNum;
+  bufMgr->unPinPage(file, pageNum, true);
+  bufMgr->unPinPage(file, newPageNum, true);
+}
+
+
+
+PageId BTreeIndex::createOverflowList(const RecordId *rids, int numRids)
+{
+  PageId pageNum;
+  Page *page;
+  bufMgr->allocPage(file, pageNum, page);
+  PostingOverflowNode *node = (PostingOverflowNode *)page;
+  numOverflowPages++;
+  node->nextPageNo = 0;
+  node->prevPageNo = 0;
+  node->numRids = numRids;
+  node->numBytes = encodeRids(rids, numRids, node->data);
+  bufMgr->unPinPage(file, pageNum, true);
+  return pageNum;
+}
+
+
+
+void BTreeIndex::searchLevel(NonLeafNodeInt *curNode, PageId &nextNodeNum, int key, bool toRight, const char *keySuffix)
+{
+  PageId *pageNoArray = nodePageNos(curNode);
+  int i = nodeOccupancy;
+  while(i >= 0 && (pageNoArray[i] == 0))
+  {
+    i--;
+  }
+  while(i > 0)
+  {
+    TRACECOMPARE();
+    int cmp = compareKeys(curNode->keyArray[i-1], nodeSuffix(curNode, i-1), key, keySuffix);
+    if (cmp < 0 || (toRight && cmp == 0))
+    {
+      break;
+    }
+    i--;
+  }
+  nextNodeNum = pageNoArray[i];
+}
+
+
+
+int BTreeIndex::getLeafEntryCount(LeafNodeInt *leaf)
+{
+  // used slots form a prefix of the leaf, binary search for the first unused one
+  int lo = 0;
+  int hi = leafOccupancy;
+  while (lo < hi)
+  {
+    int mid = (lo + hi) / 2;
+    if (leafRids(leaf)[mid].page_number == 0)
+    {
+      hi = mid;
+    }
+    else
+    {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+
+
+void BTreeIndex::insertLeafNode(LeafNodeInt *leaf, RIDKeyPair<int> entry, const char *suffixAndPayload)
+{
+  RecordId *ridArray = leafRids(leaf);
+  int count = getLeafEntryCount(leaf);
+  // find the slot, after any entries with the same key
+  int pos = count;
+  while(pos > 0 && compareKeys(leaf->keyArray[pos-1], leafSuffix(leaf, pos-1), entry.key, suffixAndPayload) > 0)
+  {
+    pos--;
+  }
+  // shift entries
+  int tailSize = keySuffixSize + payloadSize;
+  memmove(&leaf->keyArray[pos+1], &leaf->keyArray[pos], (count - pos) * sizeof(int));
+  memmove(&ridArray[pos+1], &ridArray[pos], (count - pos) * sizeof(RecordId));
+  memmove(leafSuffix(leaf, pos+1), leafSuffix(leaf, pos), (count - pos) * tailSize);
+  // insert entry
+  leaf->keyArray[pos] = entry.key;
+  ridArray[pos] = entry.rid;
+  memcpy(leafSuffix(leaf, pos), suffixAndPayload, tailSize);
+}
+
+void BTreeIndex::insertInternalNode(NonLeafNodeInt *nonleaf, PageId splitChildNum, const PageKeyPair<int> &entry)
+{
+  
+  PageId *pageNoArray = nodePageNos(nonleaf);
+  int i = nodeOccupancy;
+  while(i >= 0 && (pageNoArray[i] == 0))
+  {
+    i--;
+  }
+  while( i > 0 && pageNoArray[i] != splitChildNum)
+  {
+    nonleaf->keyArray[i] = nonleaf->keyArray[i-1];
+    memcpy(nodeSuffix(nonleaf, i), nodeSuffix(nonleaf, i-1), keySuffixSize);
+    pageNoArray[i+1] = pageNoArray[i];
+    i--;
+  }
+
+  nonleaf->keyArray[i] = entry.key;
+  memcpy(nodeSuffix(nonleaf, i), entry.keySuffix, keySuffixSize);
+  pageNoArray[i+1] = entry.pageNo;
+}
+
+
+
+
+void BTreeIndex::insertIntoLeaf(Page *leafPage, PageId leafPageNum, const RIDKeyPair<int> dataEntry, const char *suffixAndPayload, PageKeyPair<int> &newchildEntry)
+{
+  LeafNodeInt *leaf = (LeafNodeInt *)leafPage;
+  // the entry can go to the leaf, its overflow lists or a new leaf split off it: all of them the leaf's entries
+  saveLeafVersion(leafPage, leafPageNum);
+  if (leafFormat == POSTINGLEAF) {
+    insertPostingLeaf((PostingLeafNodeInt *)leafPage, leafPageNum, dataEntry, newchildEntry);
+  } else if (leafFormat == COMPRESSEDLEAF) {
+    insertCompressedLeaf((CompressedLeafNodeInt *)leafPage, leafPageNum, dataEntry, newchildEntry);
+  } else if (leafRids(leaf)[leafOccupancy - 1].page_number == 0) {
+    insertLeafNode(leaf, dataEntry, suffixAndPayload);
+    bufMgr->unPinPage(file, leafPageNum, true);
+    newchildEntry.pageNo = 0;
+  } else{
+    partitionLeaf(leaf, leafPageNum, newchildEntry, dataEntry, suffixAndPayload);
+  }
+}
+
+
+void BTreeIndex::insertEntry(const void *key, const RecordId rid, const void *payload) 
+{
+  std::lock_guard<std::recursive_mutex> latch(bufferLatch);
+  counters.inserts++;
+  TRACEOPERATION(TRACEINSERT, *((int *)key));
+  RIDKeyPair<int> dataEntry;
+  dataEntry.set(rid, *((int *)key));
+
+  // the leaf keeps the key suffix and the payload of an entry side by side
+  char suffixAndPayload[MAXKEYSUFFIXSIZE + MAXPAYLOADSIZE];
+  memcpy(suffixAndPayload, (const char *)key + sizeof(int), keySuffixSize);
+  if (payload != NULL)
+  {
+    memcpy(suffixAndPayload + keySuffixSize, payload, payloadSize);
+  }
+  else
+  {
+    memset(suffixAndPayload + keySuffixSize, 0, payloadSize);
+  }
+
+  addToStats(dataEntry.key);
+
+  if (insertBufferSize > 0)
+  {
+    addToInsertBuffer(dataEntry, suffixAndPayload);
+    if ((int)insertBuffer.size() >= insertBufferSize)
+    {
+      flushInsertBuffer();
+    }
+  }
+  else
+  {
+    insertIntoTree(dataEntry, suffixAndPayload);
+  }
+  updateBloomFilter(dataEntry.key);
+  // pages retired while readers were inside an epoch
+  bufMgr->reclaimPages();
+}
+
+
+
+void BTreeIndex::addToStats(int key)
+{
+  if (numEntries == 0 || key < minKey)
+  {
+    minKey = key;
+  }
+  if (numEntries == 0 || key > maxKey)
+  {
+    maxKey = key;
+  }
+  numEntries++;
+}
+
+
+
+void BTreeIndex::updateBloomFilter(int key)
+{
+  // the filter is only built once the constructor has filled the index
+  if (!bloomPageNos.empty())
+  {
+    std::uint64_t capacity = bloomPageNos.size() * (std::uint64_t)Page::SIZE * 8 / BLOOMBITSPERKEY;
+    // past its sized load the false positive rate climbs, so rebuild it twice as large
+    if (numEntries > capacity && bloomPageNos.size() < (size_t)MAXBLOOMPAGES)
+    {
+      buildBloomFilter();
+    }
+    else
+    {
+      addToBloomFilter(key);
+    }
+  }
+}
+
+
+
+void BTreeIndex::insertBatch(const RIDKeyPair<int> *entries, size_t n)
+{
+  std::lock_guard<std::recursive_mutex> latch(bufferLatch);
+  if (keySuffixSize > 0)
+  {
+    throw BadIndexInfoException(file->filename());
+  }
+  counters.inserts += n;
+  TRACEOPERATION(TRACEINSERT, n > 0 ? entries[0].key : 0);
+  std::vector<RIDKeyPair<int> > sorted;
+  bool inOrder = true;
+  for (size_t i = 1; i < n && inOrder; i++)
+  {
+    inOrder = entries[i - 1].key <= entries[i].key;
+  }
+  if (!inOrder)
+  {
+    sorted.assign(entries, entries + n);
+    std::stable_sort(sorted.begin(), sorted.end(),
+      [](const RIDKeyPair<int> &entry1, const RIDKeyPair<int> &entry2) { return entry1.key < entry2.key; });
+    entries = sorted.data();
+  }
+
+  char payload[MAXPAYLOADSIZE];
+  memset(payload, 0, payloadSize);
+  size_t next = 0;
+  while (next < n)
+  {
+    if (leafFormat != SLOTTEDLEAF)
+    {
+      // the other formats re-encode a leaf per insert anyway, the key order still keeps the leaf in the buffer pool
+      insertIntoTree(entries[next], payload);
+      next++;
+      continue;
+    }
+
+    // descend like insertIntoTree does, keeping the separator right of the path: keys up to it go to this leaf
+    PageId pageNum = rootPageNum;
+    Page *page;
+    bufMgr->readPage(file, pageNum, page);
+    counters.descents++;
+    bool nodeIsLeaf = isRootLeaf;
+    bool bounded = false;
+    int upperKey = 0;
+    while (!nodeIsLeaf)
+    {
+      NonLeafNodeInt *curNode = (NonLeafNodeInt *)page;
+      TRACEPAGE(pageNum, curNode->level);
+      PageId *pageNoArray = nodePageNos(curNode);
+      int numChildren = 1;
+      while (numChildren <= nodeOccupancy && pageNoArray[numChildren] != 0)
+      {
+        numChildren++;
+      }
+      int child = numChildren - 1;
+      while (child > 0 && curNode->keyArray[child - 1] >= entries[next].key)
+      {
+        child--;
+      }
+      if (child < numChildren - 1)
+      {
+        bounded = true;
+        upperKey = curNode->keyArray[child];
+      }
+      PageId childPageNum = pageNoArray[child];
+      nodeIsLeaf = curNode->level == 1;
+      bufMgr->unPinPage(file, pageNum, false);
+      pageNum = childPageNum;
+      bufMgr->readPage(file, pageNum, page);
+    }
+    TRACEPAGE(pageNum, 0);
+
+    LeafNodeInt *leaf = (LeafNodeInt *)page;
+    size_t end = next;
+    while (end < n && (!bounded || entries[end].key <= upperKey))
+    {
+      end++;
+    }
+    int room = leafOccupancy - getLeafEntryCount(leaf);
+    int num = std::min((size_t)room, end - next);
+    if (num > 0)
+    {
+      saveLeafVersion(page, pageNum);
+    }
+    mergeIntoLeaf(leaf, entries + next, num);
+    bufMgr->unPinPage(file, pageNum, num > 0);
+    next += num;
+    if (next < end)
+    {
+      // the leaf is full, this insert splits it and the rest descends again
+      insertIntoTree(entries[next], payload);
+      next++;
+    }
+  }
+
+  for (size_t i = 0; i < n; i++)
+  {
+    addToStats(entries[i].key);
+    updateBloomFilter(entries[i].key);
+  }
+  bufMgr->reclaimPages();
+}
+
+
+
+void BTreeIndex::mergeIntoLeaf(LeafNodeInt *leaf, const RIDKeyPair<int> *entries, int num)
+{
+  RecordId *ridArray = leafRids(leaf);
+  int tailSize = keySuffixSize + payloadSize;
+  int count = getLeafEntryCount(leaf);
+  // fill from the back, taking the larger of the last unplaced leaf entry and the last new entry
+  int from = count - 1;
+  int to = count + num - 1;
+  for (int i = num - 1; i >= 0; i--)
+  {
+    while (from >= 0 && leaf->keyArray[from] > entries[i].key)
+    {
+      leaf->keyArray[to] = leaf->keyArray[from];
+      ridArray[to] = ridArray[from];
+      memmove(leafSuffix(leaf, to), leafSuffix(leaf, from), tailSize);
+      from--;
+      to--;
+    }
+    leaf->keyArray[to] = entries[i].key;
+    ridArray[to] = entries[i].rid;
+    memset(leafSuffix(leaf, to), 0, tailSize);
+    to--;
+  }
+}
+
+
+
+void BTreeIndex::insertIntoTree(const RIDKeyPair<int> dataEntry, const char *suffixAndPayload)
+{
+  // descend holding one pin at a time, remembering the non-leaf nodes passed for a split to go back to
+  PageId path[MAXTREEHEIGHT];
+  int depth = 0;
+  PageId curPageNum = rootPageNum;
+  Page *curPage;
+  bufMgr->readPage(file, curPageNum, curPage);
+  counters.descents++;
+  bool nodeIsLeaf = isRootLeaf;
+  while (!nodeIsLeaf)
+  {
+    NonLeafNodeInt *curNode = (NonLeafNodeInt *)curPage;
+    TRACEPAGE(curPageNum, curNode->level);
+    PageId nextNodeNum;
+    // a key is never split between posting leaves, so its entries go to the leaf that starts with it
+    searchLevel(curNode, nextNodeNum, dataEntry.key, leafFormat == POSTINGLEAF, suffixAndPayload);
+    nodeIsLeaf = curNode->level == 1;
+    path[depth++] = curPageNum;
+    bufMgr->unPinPage(file, curPageNum, false);
+    curPageNum = nextNodeNum;
+    bufMgr->readPage(file, curPageNum, curPage);
+  }
+  TRACEPAGE(curPageNum, 0);
+
+  PageKeyPair<int> newchildEntry;
+  insertIntoLeaf(curPage, curPageNum, dataEntry, suffixAndPayload, newchildEntry);
+
+  // walk back up while nodes split, pinning each parent again only for its new separator
+  PageId splitChildNum = curPageNum;
+  while (newchildEntry.pageNo != 0 && depth > 0)
+  {
+    PageId parentPageNum = path[--depth];
+    Page *parentPage;
+    bufMgr->readPage(file, parentPageNum, parentPage);
+    NonLeafNodeInt *parent = (NonLeafNodeInt *)parentPage;
+    if (nodePageNos(parent)[nodeOccupancy] == 0)
+    {
+      insertInternalNode(parent, splitChildNum, newchildEntry);
+      newchildEntry.pageNo = 0;
+      bufMgr->unPinPage(file, parentPageNum, true);
+    }
+    else
+    {
+      partitionInternalNode(parent, parentPageNum, splitChildNum, newchildEntry);
+    }
+    splitChildNum = parentPageNum;
+  }
+}
+
+
+
+void BTreeIndex::addToInsertBuffer(const RIDKeyPair<int> &dataEntry, const char *suffixAndPayload)
+{
+  int entrySize = keySuffixSize + payloadSize;
+  // binary search for the first entry after the new one, so that the buffer stays in key order
+  size_t low = 0;
+  size_t high = insertBuffer.size();
+  while (low < high)
+  {
+    size_t mid = (low + high) / 2;
+    int cmp = compareKeys(insertBuffer[mid].key, insertBufferBytes.data() + mid * entrySize,
+      dataEntry.key, suffixAndPayload);
+    if (cmp < 0 || (cmp == 0 && !ridLess(dataEntry.rid, insertBuffer[mid].rid)))
+    {
+      low = mid + 1;
+    }
+    else
+    {
+      high = mid;
+    }
+  }
+  insertBuffer.insert(insertBuffer.begin() + low, dataEntry);
+  insertBufferBytes.insert(insertBufferBytes.begin() + low * entrySize, suffixAndPayload, suffixAndPayload + entrySize);
+}
+
+
+
+void BTreeIndex::flushInsertBuffer()
+{
+  std::lock_guard<std::recursive_mutex> latch(bufferLatch);
+  if (insertBuffer.empty())
+  {
+    return;
+  }
+  // in key order consecutive inserts land in the same leaf, which stays in the buffer pool between them
+  int entrySize = keySuffixSize + payloadSize;
+  // without suffix and payload there are no bytes, but the leaf code still copies from a valid pointer
+  char noBytes[1];
+  for (size_t i = 0; i < insertBuffer.size(); i++)
+  {
+    insertIntoTree(insertBuffer[i], entrySize > 0 ? insertBufferBytes.data() + i * entrySize : noBytes);
+  }
+  insertBuffer.clear();
+  insertBufferBytes.clear();
+}
+
+
+
+bool BTreeIndex::searchInsertBuffer(int key, RecordId &outRid)
+{
+  if (insertBuffer.empty())
+  {
+    return false;
+  }
+  RIDKeyPair<int> probe;
+  probe.key = key;
+  std::vector<RIDKeyPair<int> >::iterator it = std::lower_bound(insertBuffer.begin(), insertBuffer.end(), probe,
+    [](const RIDKeyPair<int> &entry, const RIDKeyPair<int> &probe) { return entry.key < probe.key; });
+  if (it == insertBuffer.end() || it->key != key)
+  {
+    return false;
+  }
+  outRid = it->rid;
+  return true;
+}
+
+
+
+const int *BTreeIndex::getLeafKeys(Page *leafPage, int &numKeys)
+{
+  if (leafFormat == SLOTTEDLEAF)
+  {
+    LeafNodeInt *leaf = (LeafNodeInt *)leafPage;
+    numKeys = getLeafEntryCount(leaf);
+    return leaf->keyArray;
+  }
+  if (leafFormat == COMPRESSEDLEAF)
+  {
+    CompressedLeafNodeInt *leaf = (CompressedLeafNodeInt *)leafPage;
+    numKeys = leaf->numEntries;
+    loadKeys(leaf->data, numKeys, leaf->keyWidth, leaf->baseKey, &leafKeyBuffer[0]);
+    return &leafKeyBuffer[0];
+  }
+  PostingLeafNodeInt *leaf = (PostingLeafNodeInt *)leafPage;
+  const char *in = leaf->data;
+  numKeys = 0;
+  while (in < leaf->data + leaf->numBytes)
+  {
+    PostingList list;
+    readPostingList(in, list);
+    leafKeyBuffer[numKeys++] = list.key;
+    in = list.end;
+  }
+  return &leafKeyBuffer[0];
+}
+
+
+
+RecordId BTreeIndex::getLeafRid(Page *leafPage, int i)
+{
+  RecordId rid;
+  if (leafFormat == SLOTTEDLEAF)
+  {
+    rid = leafRids((LeafNodeInt *)leafPage)[i];
+  }
+  else if (leafFormat == COMPRESSEDLEAF)
+  {
+    CompressedLeafNodeInt *leaf = (CompressedLeafNodeInt *)leafPage;
+    int keyBytes = compressedArraySize(leaf->numEntries, leaf->keyWidth);
+    int pageBytes = compressedArraySize(leaf->numEntries, leaf->pageWidth);
+    loadPageNos(leaf->data + keyBytes + i * leaf->pageWidth, 1, leaf->pageWidth, leaf->basePageNo, &rid);
+    loadSlotNos(leaf->data + keyBytes + pageBytes + i * leaf->slotWidth, 1, leaf->slotWidth, leaf->baseSlotNo, &rid);
+  }
+  else
+  {
+    PostingLeafNodeInt *leaf = (PostingLeafNodeInt *)leafPage;
+    PostingList list;
+    readPostingList(leaf->data, list);
+    for (int j = 0; j < i; j++)
+    {
+      readPostingList(list.end, list);
+    }
+    if (list.overflow)
+    {
+      Page *page;
+      bufMgr->readPage(file, list.headPageNo, page);
+      decodeRids(((PostingOverflowNode *)page)->data, 1, &rid);
+      bufMgr->unPinPage(file, list.headPageNo, false);
+    }
+    else
+    {
+      decodeRids(list.rids, 1, &rid);
+    }
+  }
+  return rid;
+}
+
+
+
+void BTreeIndex::descendToLeaf(int key, PageId &leafPageNum, Page *&leafPage)
+{
+  leafPageNum = rootPageNum;
+  bufMgr->readPage(file, leafPageNum, leafPage);
+  counters.descents++;
+  bool nodeIsLeaf = isRootLeaf;
+  while (!nodeIsLeaf)
+  {
+    NonLeafNodeInt *curNode = (NonLeafNodeInt *)leafPage;
+    TRACEPAGE(leafPageNum, curNode->level);
+    PageId nextPageNum;
+    searchLevel(curNode, nextPageNum, key, leafFormat == POSTINGLEAF);
+    nodeIsLeaf = curNode->level == 1;
+    bufMgr->unPinPage(file, leafPageNum, false);
+    leafPageNum = nextPageNum;
+    bufMgr->readPage(file, leafPageNum, leafPage);
+  }
+  TRACEPAGE(leafPageNum, 0);
+}
+
+
+
+bool BTreeIndex::probeLeaf(int key, PageId &leafPageNum, Page *&leafPage, const int *&leafKeys, int &numLeafKeys, RecordId &outRid)
+{
+  // keys are ordered across leaves, a key within the range of the pinned leaf can only be in that leaf
+  if (leafPageNum == 0 || numLeafKeys == 0 || key < leafKeys[0] || key > leafKeys[numLeafKeys - 1])
+  {
+    if (leafPageNum != 0)
+    {
+      bufMgr->unPinPage(file, leafPageNum, false);
+    }
+    routeToLeaf(key, leafPageNum, leafPage);
+    leafKeys = getLeafKeys(leafPage, numLeafKeys);
+  }
+  int pos = learnedRouting ? predictSlot(leafKeys, numLeafKeys, key)
+    : std::lower_bound(leafKeys, leafKeys + numLeafKeys, key) - leafKeys;
+  if (pos == numLeafKeys)
+  {
+    // every key of the leaf is smaller, the key can only start the right sibling
+    PageId sibPageNum = ((LeafNodeInt *)leafPage)->rightSibPageNo;
+    if (sibPageNum == 0)
+    {
+      return false;
+    }
+    PageId prevPageNum = leafPageNum;
+    leafPageNum = sibPageNum;
+    bufMgr->readPage(file, leafPageNum, leafPage);
+    TRACEPAGE(leafPageNum, 0);
+    bufMgr->unPinPage(file, prevPageNum, false);
+    leafKeys = getLeafKeys(leafPage, numLeafKeys);
+    pos = 0;
+  }
+  if (pos == numLeafKeys || leafKeys[pos] != key)
+  {
+    return false;
+  }
+  outRid = getLeafRid(leafPage, pos);
+  return true;
+}
+
+
+
+bool BTreeIndex::lookupEntry(const void *key, RecordId &outRid)
+{
+  std::lock_guard<std::recursive_mutex> latch(bufferLatch);
+  counters.lookups++;
+  TRACEOPERATION(TRACELOOKUP, *(const int *)key);
+  if (!mayContainKey(key))
+  {
+    return false;
+  }
+  PageId leafPageNum = 0;
+  Page *leafPage = NULL;
+  const int *leafKeys = NULL;
+  int numLeafKeys = 0;
+  bool found = probeLeaf(*(const int *)key, leafPageNum, leafPage, leafKeys, numLeafKeys, outRid);
+  bufMgr->unPinPage(file, leafPageNum, false);
+  return found || searchInsertBuffer(*(const int *)key, outRid);
+}
+
+
+
+int BTreeIndex::probeBatch(const int *keys, const int numKeys, RecordId *outRids, bool *outFound)
+{
+  std::lock_guard<std::recursive_mutex> latch(bufferLatch);
+  counters.lookups += numKeys;
+  TRACEOPERATION(TRACELOOKUP, numKeys > 0 ? keys[0] : 0);
+  std::vector<int> order;
+  for (int i = 0; i < numKeys; i++)
+  {
+    outFound[i] = false;
+    if (mayContainKey(&keys[i]))
+    {
+      order.push_back(i);
+    }
+  }
+  std::sort(order.begin(), order.end(), [keys](int i, int j) { return keys[i] < keys[j]; });
+
+  PageId leafPageNum = 0;
+  Page *leafPage = NULL;
+  const int *leafKeys = NULL;
+  int numLeafKeys = 0;
+  int numFound = 0;
+  for (size_t i = 0; i < order.size(); i++)
+  {
+    int k = order[i];
+    outFound[k] = probeLeaf(keys[k], leafPageNum, leafPage, leafKeys, numLeafKeys, outRids[k]);
+    if (outFound[k])
+    {
+      numFound++;
+    }
+  }
+  if (leafPageNum != 0)
+  {
+    bufMgr->unPinPage(file, leafPageNum, false);
+  }
+  for (size_t i = 0; i < order.size() && !insertBuffer.empty(); i++)
+  {
+    int k = order[i];
+    if (!outFound[k] && searchInsertBuffer(keys[k], outRids[k]))
+    {
+      outFound[k] = true;
+      numFound++;
+    }
+  }
+  return numFound;
+}
+
+
+
+
+
+void BTreeIndex::findLeaf()
+{
+  bool descending = scanDirection == DESCENDING;
+  bool startBounded = descending ? highBounded : lowBounded;
+  if (!startBounded)
+  {
+    // no start value, begin straight at the first or last leaf
+    currentPageNum = descending ? lastLeafPageNum : firstLeafPageNum;
+    bufMgr->readPage(file, currentPageNum, currentPageData);
+    TRACEPAGE(currentPageNum, 0);
+  }
+  else
+  {
+    int startKey = descending ? highValInt : lowValInt;
+    // posting leaves hold all entries of a key, a start key equal to a separator is in the leaf it starts
+    bool toRight = descending ? highOp == LTE : leafFormat == POSTINGLEAF;
+    currentPageNum = rootPageNum;
+    bufMgr->readPage(file, currentPageNum, currentPageData);
+    counters.descents++;
+    bool nodeIsLeaf = isRootLeaf;
+    while (!nodeIsLeaf)
+    {
+      NonLeafNodeInt *curNode = (NonLeafNodeInt *)currentPageData;
+      TRACEPAGE(currentPageNum, curNode->level);
+      PageId nextPageNum;
+      searchLevel(curNode, nextPageNum, startKey, toRight);
+      nodeIsLeaf = curNode->level == 1;
+      bufMgr->unPinPage(file, currentPageNum, false);
+      currentPageNum = nextPageNum;
+      bufMgr->readPage(file, currentPageNum, currentPageData);
+    }
+    TRACEPAGE(currentPageNum, 0);
+  }
+  loadLeaf();
+  nextEntry = descending ? scanCount - 1 : 0;
+
+  // skip the entries before the start value, they can continue into the neighbouring leaves
+  bool found = moveToValidEntry();
+  if (startBounded)
+  {
+    while (found)
+    {
+      int key = scanKeys[nextEntry];
+      if (descending ? (highOp == LT ? key < highValInt : key <= highValInt)
+                     : (lowOp == GT ? key > lowValInt : key >= lowValInt))
+      {
+        break;
+      }
+      skipScanKey();
+      found = moveToValidEntry();
+    }
+  }
+
+  // the first entry in scan order must also satisfy the other end of the range
+  if (found && (descending ? lowBounded : highBounded))
+  {
+    int key = scanKeys[nextEntry];
+    found = descending ? (lowOp == GT ? key > lowValInt : key >= lowValInt)
+                       : (highOp == LT ? key < highValInt : key <= highValInt);
+  }
+
+  if (!found)
+  {
+    bufMgr->unPinPage(file, currentPageNum, false);
+    scanExecuting = false;
+    throw NoSuchKeyFoundException();
+  }
+}
+
+
+bool BTreeIndex::moveToValidEntry()
+{
+  int step = scanDirection == DESCENDING ? -1 : 1;
+  while (true)
+  {
+    if (overflowPageNum != 0)
+    {
+      // inside a posting list in overflow pages, go on to the next page of the list or past the list
+      if (overflowEntry >= 0 && overflowEntry < overflowCount)
+      {
+        return true;
+      }
+      PageId nextPageNum = step > 0 ? overflowNextPageNum : overflowPrevPageNum;
+      if (nextPageNum != 0)
+      {
+        loadOverflowPage(nextPageNum);
+      }
+      else
+      {
+        skipScanKey();
+      }
+      continue;
+    }
+
+    if (nextEntry < 0 || nextEntry >= scanCount)
+    {
+      LeafNodeInt *leaf = (LeafNodeInt *)currentPageData;
+      PageId sibPageNum = step > 0 ? leaf->rightSibPageNo : leaf->leftSibPageNo;
+      if (sibPageNum == 0)
+      {
+        return false;
+      }
+      // hand over hand, the next leaf is pinned before the current one is released
+      PageId prevPageNum = currentPageNum;
+      currentPageNum = sibPageNum;
+      bufMgr->readPage(file, currentPageNum, currentPageData);
+      TRACEPAGE(currentPageNum, 0);
+      bufMgr->unPinPage(file, prevPageNum, false);
+      loadLeaf();
+      nextEntry = step > 0 ? 0 : scanCount - 1;
+      continue;
+    }
+
+    if (scanRids[nextEntry].page_number == 0)
+    {
+      // the entry stands for a posting list in overflow pages
+      const std::pair<PageId, PageId> &overflowList = scanOverflowLists[scanRids[nextEntry].slot_number];
+      loadOverflowPage(step > 0 ? overflowList.first : overflowList.second);
+      continue;
+    }
+    return true;
+  }
+}
+
+
+void BTreeIndex::loadLeaf()
+{
+  if (leafFormat == SLOTTEDLEAF)
+  {
+    LeafNodeInt *leaf = (LeafNodeInt *)currentPageData;
+    scanKeys = leaf->keyArray;
+    scanRids = leafRids(leaf);
+    scanCount = getLeafEntryCount(leaf);
+    return;
+  }
+
+  if (leafFormat == COMPRESSEDLEAF)
+  {
+    CompressedLeafNodeInt *leaf = (CompressedLeafNodeInt *)currentPageData;
+    scanCount = leaf->numEntries;
+    decodeCompressedLeaf(leaf, &scanKeyBuffer[0], &scanRidBuffer[0]);
+    scanKeys = &scanKeyBuffer[0];
+    scanRids = &scanRidBuffer[0];
+    return;
+  }
+
+  // one entry per rid, a list in overflow pages becomes a single entry pointing at scanOverflowLists
+  PostingLeafNodeInt *leaf = (PostingLeafNodeInt *)currentPageData;
+  const char *in = leaf->data;
+  const char *end = leaf->data + leaf->numBytes;
+  scanOverflowLists.clear();
+  scanCount = 0;
+  while (in < end)
+  {
+    PostingList list;
+    readPostingList(in, list);
+    if (list.overflow)
+    {
+      scanKeyBuffer[scanCount] = list.key;
+      scanRidBuffer[scanCount].page_number = 0;
+      scanRidBuffer[scanCount].slot_number = scanOverflowLists.size();
+      scanOverflowLists.push_back(std::make_pair(list.headPageNo, list.tailPageNo));
+      scanCount++;
+    }
+    else
+    {
+      decodeRids(list.rids, list.numRids, &scanRidBuffer[scanCount]);
+      std::fill(&scanKeyBuffer[scanCount], &scanKeyBuffer[scanCount] + list.numRids, list.key);
+      scanCount += list.numRids;
+    }
+    in = list.end;
+  }
+  scanKeys = &scanKeyBuffer[0];
+  scanRids = &scanRidBuffer[0];
+}
+
+
+void BTreeIndex::loadOverflowPage(PageId pageNum)
+{
+  Page *page;
+  bufMgr->readPage(file, pageNum, page);
+  TRACEPAGE(pageNum, -1);
+  PostingOverflowNode *node = (PostingOverflowNode *)page;
+  overflowPageNum = pageNum;
+  overflowPrevPageNum = node->prevPageNo;
+  overflowNextPageNum = node->nextPageNo;
+  overflowCount = node->numRids;
+  decodeRids(node->data, overflowCount, &overflowRidBuffer[0]);
+  bufMgr->unPinPage(file, pageNum, false);
+  overflowEntry = scanDirection == DESCENDING ? overflowCount - 1 : 0;
+}
+
+
+void BTreeIndex::appendLeafEntries(Page *leafPage, std::vector<int> &keys, std::vector<RecordId> &rids)
+{
+  size_t num = keys.size();
+  if (leafFormat == SLOTTEDLEAF)
+  {
+    LeafNodeInt *leaf = (LeafNodeInt *)leafPage;
+    int count = getLeafEntryCount(leaf);
+    keys.insert(keys.end(), leaf->keyArray, leaf->keyArray + count);
+    rids.insert(rids.end(), leafRids(leaf), leafRids(leaf) + count);
+    return;
+  }
+
+  if (leafFormat == COMPRESSEDLEAF)
+  {
+    CompressedLeafNodeInt *leaf = (CompressedLeafNodeInt *)leafPage;
+    keys.resize(num + leaf->numEntries);
+    rids.resize(num + leaf->numEntries);
+    decodeCompressedLeaf(leaf, &keys[num], &rids[num]);
+    return;
+  }
+
+  PostingLeafNodeInt *leaf = (PostingLeafNodeInt *)leafPage;
+  const char *in = leaf->data;
+  const char *end = leaf->data + leaf->numBytes;
+  while (in < end)
+  {
+    PostingList list;
+    readPostingList(in, list);
+    if (!list.overflow)
+    {
+      rids.resize(num + list.numRids);
+      decodeRids(list.rids, list.numRids, &rids[num]);
+      num += list.numRids;
+    }
+    for (PageId pageNum = list.overflow ? list.headPageNo : 0; pageNum != 0; )
+    {
+      Page *page;
+      bufMgr->readPage(file, pageNum, page);
+      PostingOverflowNode *node = (PostingOverflowNode *)page;
+      rids.resize(num + node->numRids);
+      decodeRids(node->data, node->numRids, &rids[num]);
+      num += node->numRids;
+      PageId nextPageNum = node->nextPageNo;
+      bufMgr->unPinPage(file, pageNum, false);
+      pageNum = nextPageNum;
+    }
+    keys.resize(num, list.key);
+    in = list.end;
+  }
+}
+
+
+void BTreeIndex::startScan(const void* lowValParm,
+           const Operator lowOpParm,
+           const void* highValParm,
+           const Operator highOpParm,
+           const ScanDirection direction)
+{
+  this->lowOp = lowOpParm;
+  this->highOp = highOpParm;
+  this->lowBounded = lowValParm != NULL;
+  this->highBounded = highValParm != NULL;
+  if(lowBounded && lowOp != GT){ //Checking the opcodes
+    if(lowOp != GTE){
+      throw BadOpcodesException();
+    }
+  }
+  if(highBounded && highOp != LT){
+    if(highOp != LTE){
+      throw BadOpcodesException();
+    }
+  }
+  if(lowBounded){
+    this->lowValInt = *(int*)(lowValParm);
+  }
+  if(highBounded){
+    this->highValInt = *(int*)(highValParm);
+  }
+
+  
+  if(lowBounded && highBounded && this->highValInt < this->lowValInt){ //Checking that the bounds are correct
+    throw BadScanrangeException();
+  }
+  if(scanExecuting == true){ //Checks for an Existing Scan
+    endScan();
+  }
+  counters.scans++;
+  TRACEBEGIN(TRACESCAN, lowBounded ? lowValInt : (highBounded ? highValInt : 0));
+  // the scan reads the leaves only
+  flushInsertBuffer();
+  scanExecuting = true; //Sets there to be a scan going
+  scanDirection = direction;
+  overflowPageNum = 0;
+  if(lowBounded && highBounded && lowOp == GTE && highOp == LTE && lowValInt == highValInt && !mayContainKey(&lowValInt)){
+    // an equality scan of a key the Bloom filter rules out
+    scanExecuting = false;
+    throw NoSuchKeyFoundException();
+  }
+  findLeaf();//finds the leaf
+  
+}
+
+
+void BTreeIndex::scanNext(RecordId& outRid) 
+{
+ if(!scanExecuting){ //Checking that scan has been initialized
+    throw ScanNotInitializedException();
+  }
+  if(!moveToValidEntry()){ //moves on to the next sibling once the current leaf is used up
+    throw IndexScanCompletedException();
+  }
+  if(isPastScanEnd(scanKeys[nextEntry])){ //keys are sorted, so the first key past the end value ends the scan
+    throw IndexScanCompletedException();
+  }
+  outRid = scanRid();
+  advanceScan();
+}
+
+
+int BTreeIndex::scanNextBatch(RIDKeyPair<int>* outPairs, const int maxPairs, char* outPayloads, char* outKeySuffixes)
+{
+  if(!scanExecuting){
+    throw ScanNotInitializedException();
+  }
+  if(maxPairs <= 0){
+    throw BadScanrangeException();
+  }
+  int numPairs = 0;
+  bool pastEnd = false;
+  int step = scanDirection == DESCENDING ? -1 : 1;
+  while(numPairs < maxPairs && !pastEnd && moveToValidEntry()){
+    if(overflowPageNum != 0){
+      // copy out as much of the current overflow page as fits, all its rids have the same key
+      int key = scanKeys[nextEntry];
+      if(isPastScanEnd(key)){
+        pastEnd = true;
+        break;
+      }
+      while(numPairs < maxPairs && overflowEntry >= 0 && overflowEntry < overflowCount){
+        outPairs[numPairs].set(overflowRidBuffer[overflowEntry], key);
+        numPairs++;
+        overflowEntry += step;
+      }
+      continue;
+    }
+    // copy out as much of the current leaf as fits
+    LeafNodeInt* currentPage = (LeafNodeInt*)(currentPageData);
+    int stopEntry = scanDirection == DESCENDING ? -1 : scanCount;
+    while(numPairs < maxPairs && nextEntry != stopEntry){
+      int key = scanKeys[nextEntry];
+      if(isPastScanEnd(key)){
+        pastEnd = true;
+        break;
+      }
+      if(scanRids[nextEntry].page_number == 0){
+        // a posting list in overflow pages, moveToValidEntry() steps into it
+        break;
+      }
+      outPairs[numPairs].set(scanRids[nextEntry], key);
+      if(outPayloads != NULL){
+        memcpy(outPayloads + numPairs * payloadSize, leafPayload(currentPage, nextEntry), payloadSize);
+      }
+      if(outKeySuffixes != NULL){
+        memcpy(outKeySuffixes + numPairs * keySuffixSize, leafSuffix(currentPage, nextEntry), keySuffixSize);
+      }
+      numPairs++;
+      nextEntry += step;
+    }
+  }
+  if(numPairs == 0){
+    throw IndexScanCompletedException();
+  }
+  return numPairs;
+}
+
+
+bool BTreeIndex::isPastScanEnd(int key)
+{
+  if(scanDirection == DESCENDING){
+    return lowBounded && (lowOp == GT ? key <= lowValInt : key < lowValInt);
+  }
+  return highBounded && (highOp == LT ? key >= highValInt : key > highValInt);
+}
+
+
+void BTreeIndex::endScan() 
+{
+  if(!scanExecuting){ //checks that a scan is executing
+    throw ScanNotInitializedException();
+    scanExecuting = false;
+    return;
+  }
+  bufMgr->unPinPage(file, currentPageNum, false); //unpins the only pinned paged which is the current page
+  scanExecuting = false;//sets scan executing to false
+  overflowPageNum = 0;
+  TRACEEND();
+
+
+}
+
+
+int BTreeIndex::splitScanRange(const void* lowValParm,
+           const Operator lowOpParm,
+           const void* highValParm,
+           const Operator highOpParm,
+           const int numRanges,
+           std::vector<ScanRange>& outRanges)
+{
+  ScanRange range;
+  range.lowBounded = lowValParm != NULL;
+  range.lowVal = range.lowBounded ? *(const int *)lowValParm : 0;
+  range.lowOp = lowOpParm;
+  range.highBounded = highValParm != NULL;
+  range.highVal = range.highBounded ? *(const int *)highValParm : 0;
+  range.highOp = highOpParm;
+  if ((range.lowBounded && lowOpParm != GT && lowOpParm != GTE) || (range.highBounded && highOpParm != LT && highOpParm != LTE))
+  {
+    throw BadOpcodesException();
+  }
+  if (range.lowBounded && range.highBounded && range.highVal < range.lowVal)
+  {
+    throw BadScanrangeException();
+  }
+  std::lock_guard<std::recursive_mutex> latch(bufferLatch);
+  // cursors read the leaves only
+  flushInsertBuffer();
+
+  // descend level by level through the nodes overlapping the range until there are enough subtrees,
+  // keeping for each subtree the separator left of it
+  std::vector<PageId> nodes(1, rootPageNum);
+  std::vector<int> nodeFences(1, 0);
+  std::vector<PageId> children;
+  std::vector<int> childFences;
+  int childLevel = 0;
+  while (!isRootLeaf && numRanges > 1)
+  {
+    children.clear();
+    childFences.clear();
+    int level = 1;
+    for (size_t n = 0; n < nodes.size(); n++)
+    {
+      Page *page;
+      bufMgr->readPage(file, nodes[n], page);
+      NonLeafNodeInt *node = (NonLeafNodeInt *)page;
+      PageId *pageNoArray = nodePageNos(node);
+      for (int i = 0; i <= nodeOccupancy && pageNoArray[i] != 0; i++)
+      {
+        // child i holds the keys between separators i-1 and i, keys equal to a separator on either side
+        bool last = i == nodeOccupancy || pageNoArray[i + 1] == 0;
+        bool reachesLow = !range.lowBounded || last || node->keyArray[i] >= range.lowVal;
+        bool reachesHigh = !range.highBounded || i == 0 || node->keyArray[i - 1] <= range.highVal;
+        if (reachesLow && reachesHigh)
+        {
+          children.push_back(pageNoArray[i]);
+          childFences.push_back(i == 0 ? nodeFences[n] : node->keyArray[i - 1]);
+        }
+      }
+      level = node->level;
+      bufMgr->unPinPage(file, nodes[n], false);
+    }
+    childLevel = level - 1;
+    if (level == 1 || (int)children.size() >= numRanges * SPLITOVERSAMPLE)
+    {
+      break;
+    }
+    nodes.swap(children);
+    nodeFences.swap(childFences);
+  }
+
+  // subtrees of one level are about the same size: the average fan-out to the power of their level, in leaves
+  double fanout = numInternalPages == 0 ? 1 : (double)(numLeafPages + numInternalPages - 1) / numInternalPages;
+  double entriesPerChild = (double)numEntries / std::max(numLeafPages, 1) * std::pow(fanout, childLevel);
+
+  // cut at the fence of every numRanges-th share of the subtrees, skipping cuts that would leave a part without keys
+  ScanRange whole = range;
+  outRanges.clear();
+  int firstChild = 0;
+  int numChildren = children.size();
+  for (int k = 1; k < numRanges && numChildren > 1; k++)
+  {
+    int child = (long)k * numChildren / numRanges;
+    int cut = childFences[child];
+    bool afterLow = !range.lowBounded || (cut > range.lowVal && (range.lowOp == GTE || cut - 1 > range.lowVal));
+    bool beforeHigh = !whole.highBounded || (whole.highOp == LT ? cut < whole.highVal : cut <= whole.highVal);
+    if (child == firstChild || !afterLow || !beforeHigh)
+    {
+      continue;
+    }
+    range.highBounded = true;
+    range.highVal = cut;
+    range.highOp = LT;
+    range.estimatedEntries = (std::uint64_t)((child - firstChild) * entriesPerChild);
+    outRanges.push_back(range);
+    range.lowBounded = true;
+    range.lowVal = cut;
+    range.lowOp = GTE;
+    firstChild = child;
+  }
+  range.highBounded = whole.highBounded;
+  range.highVal = whole.highVal;
+  range.highOp = whole.highOp;
+  range.estimatedEntries = numChildren == 0 ? numEntries : (std::uint64_t)((numChildren - firstChild) * entriesPerChild);
+  outRanges.push_back(range);
+  return outRanges.size();
+}
+
+
+std::uint64_t BTreeIndex::beginSnapshot()
+{
+  std::uint64_t snapshotEpoch = epoch;
+  epoch++;
+  activeSnapshots.insert(snapshotEpoch);
+  return snapshotEpoch;
+}
+
+
+void BTreeIndex::endSnapshot(std::uint64_t snapshotEpoch)
+{
+  activeSnapshots.erase(activeSnapshots.find(snapshotEpoch));
+  // a version or origin of epoch e serves the snapshots older than e only
+  bool anyLeft = !activeSnapshots.empty();
+  std::uint64_t oldest = anyLeft ? *activeSnapshots.begin() : 0;
+  for (std::map<PageId, std::vector<LeafVersion> >::iterator it = leafVersions.begin(); it != leafVersions.end(); )
+  {
+    std::vector<LeafVersion> &versions = it->second;
+    size_t retired = 0;
+    while (retired < versions.size() && (!anyLeft || versions[retired].epoch <= oldest))
+    {
+      retired++;
+    }
+    versions.erase(versions.begin(), versions.begin() + retired);
+    if (versions.empty())
+    {
+      leafVersions.erase(it++);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  for (std::map<PageId, LeafOrigin>::iterator it = leafOrigins.begin(); it != leafOrigins.end(); )
+  {
+    if (!anyLeft || it->second.epoch <= oldest)
+    {
+      leafOrigins.erase(it++);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+
+void BTreeIndex::saveLeafVersion(Page *leafPage, PageId leafPageNum)
+{
+  if (activeSnapshots.empty())
+  {
+    return;
+  }
+  std::uint64_t newest = *activeSnapshots.rbegin();
+  // a leaf created after the newest snapshot is not seen by any, and a leaf changed since keeps its version
+  std::map<PageId, LeafOrigin>::iterator origin = leafOrigins.find(leafPageNum);
+  if (origin != leafOrigins.end() && origin->second.epoch > newest)
+  {
+    return;
+  }
+  std::vector<LeafVersion> &versions = leafVersions[leafPageNum];
+  if (!versions.empty() && versions.back().epoch > newest)
+  {
+    return;
+  }
+  versions.push_back(LeafVersion());
+  LeafVersion &version = versions.back();
+  version.epoch = epoch;
+  version.rightSibPageNo = ((LeafNodeInt *)leafPage)->rightSibPageNo;
+  appendLeafEntries(leafPage, version.keys, version.rids);
+  counters.leafVersions++;
+}
+
+
+void BTreeIndex::recordLeafOrigin(PageId newPageNum, PageId leafPageNum)
+{
+  if (!activeSnapshots.empty())
+  {
+    LeafOrigin origin = {epoch, leafPageNum};
+    leafOrigins[newPageNum] = origin;
+  }
+}
+
+
+PageId BTreeIndex::snapshotLeaf(PageId leafPageNum, std::uint64_t snapshotEpoch)
+{
+  // leaves only split, so the entries of a newer leaf were in the leaf it split off from, or in that one's origin
+  std::map<PageId, LeafOrigin>::iterator origin = leafOrigins.find(leafPageNum);
+  while (origin != leafOrigins.end() && origin->second.epoch > snapshotEpoch)
+  {
+    leafPageNum = origin->second.splitPageNo;
+    origin = leafOrigins.find(leafPageNum);
+  }
+  return leafPageNum;
+}
+
+
+PageId BTreeIndex::appendSnapshotEntries(PageId leafPageNum, std::uint64_t snapshotEpoch, std::vector<int> &keys, std::vector<RecordId> &rids)
+{
+  // the first version newer than the snapshot holds the entries from before the first change after it
+  std::map<PageId, std::vector<LeafVersion> >::iterator it = leafVersions.find(leafPageNum);
+  if (it != leafVersions.end())
+  {
+    for (size_t i = 0; i < it->second.size(); i++)
+    {
+      const LeafVersion &version = it->second[i];
+      if (version.epoch > snapshotEpoch)
+      {
+        keys.insert(keys.end(), version.keys.begin(), version.keys.end());
+        rids.insert(rids.end(), version.rids.begin(), version.rids.end());
+        return version.rightSibPageNo;
+      }
+    }
+  }
+  Page *page;
+  bufMgr->readPage(file, leafPageNum, page);
+  appendLeafEntries(page, keys, rids);
+  PageId sibPageNum = ((LeafNodeInt *)page)->rightSibPageNo;
+  bufMgr->unPinPage(file, leafPageNum, false);
+  return sibPageNum;
+}
+
+
+IndexSnapshot::IndexSnapshot(BTreeIndex *index)
+  : index(index)
+{
+  std::lock_guard<std::recursive_mutex> latch(index->bufferLatch);
+  index->flushInsertBuffer();
+  epoch = index->beginSnapshot();
+}
+
+
+IndexSnapshot::~IndexSnapshot()
+{
+  std::lock_guard<std::recursive_mutex> latch(index->bufferLatch);
+  index->endSnapshot(epoch);
+}
+
+
+ScanCursor::ScanCursor(BTreeIndex *index, const ScanRange &range, const IndexSnapshot *snapshot)
+  : index(index), range(range), snapshot(snapshot), nextEntry(0), nextPageNum(0), started(false), epochSlot(-1)
+{
+}
+
+
+ScanCursor::~ScanCursor()
+{
+  leaveEpoch();
+}
+
+
+void ScanCursor::leaveEpoch()
+{
+  if (epochSlot >= 0)
+  {
+    index->bufMgr->getEpochs().leave(epochSlot);
+    epochSlot = -1;
+  }
+}
+
+
+void ScanCursor::fetchLeaves()
+{
+  keys.clear();
+  rids.clear();
+  nextEntry = 0;
+  if (!started)
+  {
+    // inside an epoch until no page number of the chain is held, entered before the latch is taken
+    epochSlot = index->bufMgr->getEpochs().enter();
+  }
+  std::lock_guard<std::recursive_mutex> latch(index->bufferLatch);
+  PageId pageNum = nextPageNum;
+  Page *page = NULL;
+  if (!started)
+  {
+    started = true;
+    index->counters.scans++;
+    if (range.lowBounded)
+    {
+      // the first leaf stays pinned from the descent
+      index->descendToLeaf(range.lowVal, pageNum, page);
+      if (snapshot != NULL)
+      {
+        // the leaf found may have been split off after the snapshot
+        index->bufMgr->unPinPage(index->file, pageNum, false);
+        page = NULL;
+        pageNum = index->snapshotLeaf(pageNum, snapshot->getEpoch());
+      }
+    }
+    else
+    {
+      pageNum = index->firstLeafPageNum;
+    }
+  }
+  for (int i = 0; i < CURSORPREFETCHLEAVES && pageNum != 0; i++)
+  {
+    if (snapshot != NULL)
+    {
+      pageNum = index->appendSnapshotEntries(pageNum, snapshot->getEpoch(), keys, rids);
+    }
+    else
+    {
+      if (page == NULL)
+      {
+        index->bufMgr->readPage(index->file, pageNum, page);
+      }
+      index->appendLeafEntries(page, keys, rids);
+      PageId sibPageNum = ((LeafNodeInt *)page)->rightSibPageNo;
+      index->bufMgr->unPinPage(index->file, pageNum, false);
+      page = NULL;
+      pageNum = sibPageNum;
+    }
+    // keys are sorted, the leaves after one that reaches past the range are not needed
+    if (!keys.empty() && range.highBounded && (range.highOp == LT ? keys.back() >= range.highVal : keys.back() > range.highVal))
+    {
+      pageNum = 0;
+    }
+  }
+  nextPageNum = pageNum;
+  if (nextPageNum == 0)
+  {
+    leaveEpoch();
+  }
+}
+
+
+int ScanCursor::nextBatch(RIDKeyPair<int>* outPairs, const int maxPairs)
+{
+  if (maxPairs <= 0)
+  {
+    throw BadScanrangeException();
+  }
+  int numPairs = 0;
+  while (numPairs < maxPairs)
+  {
+    if (nextEntry == keys.size())
+    {
+      if (started && nextPageNum == 0)
+      {
+        break;
+      }
+      fetchLeaves();
+      continue;
+    }
+    int key = keys[nextEntry];
+    if (range.lowBounded && (range.lowOp == GT ? key <= range.lowVal : key < range.lowVal))
+    {
+      // the first leaf can start before the range
+      nextEntry++;
+      continue;
+    }
+    if (range.highBounded && (range.highOp == LT ? key >= range.highVal : key > range.highVal))
+    {
+      keys.clear();
+      nextEntry = 0;
+      nextPageNum = 0;
+      leaveEpoch();
+      break;
+    }
+    outPairs[numPairs].set(rids[nextEntry], key);
+    numPairs++;
+    nextEntry++;
+  }
+  if (numPairs == 0)
+  {
+    throw IndexScanCompletedException();
+  }
+  return numPairs;
+}
+
+void BTreeIndex::beginTrace(TracedOperation op, int key)
+{
+  if (tracing)
+  {
+    endTrace();
+  }
+  tracing = true;
+  currentTrace.op = op;
+  currentTrace.key = key;
+  currentTrace.splits = 0;
+  currentTrace.comparisons = 0;
+  currentTrace.bufferMisses = 0;
+  pagesAccessed.clear();
+  traceMissMark = bufMgr->getBufStats().diskreads;
+}
+
+
+
+void BTreeIndex::tracePage(PageId pageNo, int level)
+{
+  if (!tracing)
+  {
+    return;
+  }
+  // the page missed if the buffer pool read from disk since the previous traced read; every buffer
+  // manager counts disk reads, not all of them count misses
+  std::uint64_t misses = bufMgr->getBufStats().diskreads;
+  PageAccess access;
+  access.pageNo = pageNo;
+  access.level = level;
+  access.miss = misses != traceMissMark;
+  traceMissMark = misses;
+  currentTrace.bufferMisses += access.miss;
+  pagesAccessed.push_back(access);
+}
+
+
+
+void BTreeIndex::endTrace()
+{
+  if (!tracing)
+  {
+    return;
+  }
+  tracing = false;
+  currentTrace.pages = pagesAccessed;
+  if (traces.size() < (size_t)MAXTRACES)
+  {
+    traces.push_back(currentTrace);
+  }
+  else
+  {
+    traces[numTraces % MAXTRACES] = currentTrace;
+  }
+  numTraces++;
+}
+
+
+
+void BTreeIndex::clearTraces()
+{
+  traces.clear();
+  numTraces = 0;
+}
+
+
+
+double BTreeIndex::getAverageLeafFill() const
+{
+  int capacity = leafFormat == COMPRESSEDLEAF ? COMPRESSEDLEAFMAXENTRIES : leafOccupancy;
+  return numLeafPages == 0 ? 0 : (double)numEntries / ((double)numLeafPages * capacity);
+}
+
+
+
+void BTreeIndex::dumpCounters(std::ostream &out) const
+{
+  out << "inserts " << counters.inserts << "\n";
+  out << "lookups " << counters.lookups << "\n";
+  out << "scans " << counters.scans << "\n";
+  out << "descents " << counters.descents << "\n";
+  out << "leaf versions " << counters.leafVersions << "\n";
+  for (int level = 0; level < height && level < MAXTREEHEIGHT; level++)
+  {
+    out << "splits level " << level << " " << counters.splitsByLevel[level] << "\n";
+  }
+  out << "average leaf fill " << getAverageLeafFill() << "\n";
+}
+
+
+
+void BTreeIndex::dumpTraces(std::ostream &out, bool onlyMisses) const
+{
+#ifndef BTREETRACE
+  out << "tracing not compiled in, define BTREETRACE\n";
+#endif
+  const char *opNames[] = {"insert", "lookup", "scan"};
+  size_t first = traces.size() < (size_t)MAXTRACES ? 0 : numTraces % MAXTRACES;
+  for (size_t i = 0; i < traces.size(); i++)
+  {
+    const OperationTrace &trace = traces[(first + i) % traces.size()];
+    if (onlyMisses && trace.bufferMisses == 0)
+    {
+      continue;
+    }
+    out << opNames[trace.op] << " key " << trace.key << " pages";
+    for (const PageAccess &access : trace.pages)
+    {
+      out << " " << access.pageNo << "@" << access.level << (access.miss ? "*" : "");
+    }
+    out << " splits " << trace.splits << " comparisons " << trace.comparisons
+        << " misses " << trace.bufferMisses << "\n";
+  }
 }
 
 }
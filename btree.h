@@ -18,6 +18,9 @@
 #include "buffer.h"
 
 #include<vector>
+#include<mutex>
+#include<map>
+#include<set>
 
 namespace badgerdb
 {
@@ -43,12 +46,146 @@ enum Operator
   GT    /* Greater Than */
 };
 
+/**
+ * @brief Order in which a scan returns entries. Passed to BTreeIndex::startScan() method.
+ */
+enum ScanDirection
+{
+  ASCENDING,  /* Smallest key first, starting at the low value */
+  DESCENDING  /* Largest key first, starting at the high value */
+};
+
+
+/**
+ * @brief Layout of the leaf pages of an index. Chosen when the index is created and recorded in the meta page.
+ */
+enum LeafFormat
+{
+  SLOTTEDLEAF,    /* One (key, rid) slot per entry, see LeafNodeInt */
+  POSTINGLEAF,    /* Every distinct key once with the list of its rids, see PostingLeafNodeInt */
+  COMPRESSEDLEAF  /* Keys and rids stored as offsets from per-leaf minimums, see CompressedLeafNodeInt */
+};
+
+
+/**
+ * @brief Version of the on-disk index format. Stored in the meta page and checked when an
+ * existing index file is opened, so that files written with an older layout are rejected.
+ */
+const int INDEXFORMATVERSION = 7;
+
+/**
+ * @brief Maximum number of INCLUDE attributes stored in the leaves of a covering index.
+ */
+const int MAXINCLUDEATTRS = 4;
+
+/**
+ * @brief Maximum number of payload bytes (all INCLUDE attributes together) per leaf entry.
+ */
+const int MAXPAYLOADSIZE = 256;
+
+/**
+ * @brief Maximum number of trailing key attributes of a composite key, after the leading INTEGER attribute.
+ */
+const int MAXTRAILINGKEYATTRS = 3;
+
+/**
+ * @brief Maximum number of bytes taken by the trailing key attributes of a composite key.
+ */
+const int MAXKEYSUFFIXSIZE = 64;
+
+/**
+ * @brief Maximum number of bytes the rids of one key take in a posting leaf. A longer posting list
+ * moves to a chain of overflow pages and only its page numbers stay in the leaf.
+ */
+const int POSTINGINLINELIMIT = Page::SIZE / 4;
+
+/**
+ * @brief Number of bytes available for posting lists in a posting leaf.
+ */
+//                                                           counters          sibling ptrs
+const int POSTINGLEAFDATASIZE = Page::SIZE - 2 * sizeof( int ) - 2 * sizeof( PageId );
+
+/**
+ * @brief Number of bytes available for rids in a posting list overflow page.
+ */
+//                                                          page links          counters
+const int OVERFLOWDATASIZE = Page::SIZE - 2 * sizeof( PageId ) - 2 * sizeof( int );
+
+/**
+ * @brief Number of bytes available for entries in a compressed leaf.
+ */
+//                                                              header           sibling ptrs
+const int COMPRESSEDLEAFDATASIZE = Page::SIZE - 5 * sizeof( int ) - 2 * sizeof( PageId );
+
+/**
+ * @brief Maximum number of entries in a compressed leaf. Small enough that either half of a split leaf
+ * fits even when its keys, page numbers and slot numbers need their full width; the 8 bytes cover the
+ * padding between the arrays.
+ */
+const int COMPRESSEDLEAFMAXENTRIES = 2 * ( ( COMPRESSEDLEAFDATASIZE - 8 ) / ( sizeof( int ) + sizeof( PageId ) + sizeof( SlotId ) ) ) - 1;
+
+/**
+ * @brief Bits of Bloom filter per entry the filter is sized for, about 1% false positives.
+ */
+const int BLOOMBITSPERKEY = 10;
+
+/**
+ * @brief Number of bits a key sets in the Bloom filter. All of them are in one block of the filter.
+ */
+const int BLOOMNUMPROBES = 7;
+
+/**
+ * @brief Size in bytes of a Bloom filter block, one cache line.
+ */
+const int BLOOMBLOCKSIZE = 64;
+
+/**
+ * @brief Maximum number of pages of a Bloom filter, room for about 6 million entries. A larger index
+ * keeps a filter of this size and gets more false positives.
+ */
+const int MAXBLOOMPAGES = 1024;
+
+/**
+ * @brief Maximum number of levels of a tree, the size of the path an insert records. Even the smallest
+ * fanout, with the largest key suffix, reaches billions of entries well before this.
+ */
+const int MAXTREEHEIGHT = 16;
+
+/**
+ * @brief Percentage of its entries a leaf keeps when it splits because of an insert past the largest key
+ * of the index. Ascending keys then leave the leaves nearly full instead of half full.
+ */
+const int APPENDSPLITPERCENT = 90;
+
+/**
+ * @brief Largest distance, in leaves, between the leaf a learned routing segment predicts for a leaf's
+ * first key and that leaf itself.
+ */
+const int LEARNEDERRORBOUND = 4;
+
+/**
+ * @brief Number of operation traces an index keeps, the most recent ones. Only used when the index is
+ * compiled with BTREETRACE defined; without it the trace hooks compile to nothing.
+ */
+const int MAXTRACES = 1024;
+
+/**
+ * @brief Number of subtrees splitScanRange wants per sub-range before it cuts a range. Cuts fall on the
+ * boundaries of subtrees of one level, so more subtrees per sub-range give sub-ranges of more even size.
+ */
+const int SPLITOVERSAMPLE = 4;
+
+/**
+ * @brief Number of leaves a ScanCursor copies out of the buffer pool at a time, holding the index latch
+ * once for all of them.
+ */
+const int CURSORPREFETCHLEAVES = 8;
 
 /**
  * @brief Number of key slots in B+Tree leaf for INTEGER key.
  */
-//                                                  sibling ptr             key               rid
-const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+//                                                  sibling ptrs                key               rid
+const  int INTARRAYLEAFSIZE = ( Page::SIZE - 2 * sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
 
 /**
  * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
@@ -56,6 +193,244 @@ const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int
 //                                                     level     extra pageNo                  key       pageNo
 const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
 
+/**
+ * @brief Describes an attribute of the records of the base relation: where it is stored and what type it has.
+ */
+struct AttrDesc{
+  /**
+   * Offset of the attribute inside the record.
+   */
+  int attrByteOffset;
+
+  /**
+   * Type of the attribute.
+   */
+  Datatype attrType;
+
+  /**
+   * Length of the attribute in bytes. Only used for STRING attributes, INTEGER and DOUBLE have their native size.
+   */
+  int attrLength;
+};
+
+/**
+ * @brief Optional settings passed to the BTreeIndex constructor. They shape the index file, so they are
+ * recorded in the meta page and must be the same when an existing index file is opened again.
+ */
+struct IndexOptions{
+  /**
+   * Attributes copied into the leaves next to each rid (INCLUDE columns). A scan over a covering index can
+   * return them with the keys, so queries that only need these attributes never read the base relation.
+   * Every attribute takes room in each leaf entry, which lowers the number of entries per leaf.
+   */
+  std::vector<AttrDesc> includeAttrs;
+
+  /**
+   * Key attributes following the leading INTEGER attribute given to the constructor, making the key composite.
+   * Entries are ordered lexicographically on the leading attribute and then on these attributes. The bytes
+   * of the trailing attributes (the key suffix) are stored with every leaf entry and every separator.
+   */
+  std::vector<AttrDesc> trailingKeyAttrs;
+
+  /**
+   * Layout of the leaf pages. POSTINGLEAF suits columns with few distinct values: each key is stored once,
+   * followed by its rids in ascending order with the page numbers delta encoded, and long lists spill into
+   * overflow pages. Duplicates of a key come back in rid order. COMPRESSEDLEAF suits dense keys such as
+   * sequential ids: keys and rids are stored in as few bytes as the spread of their values in the leaf
+   * allows, and are decoded a leaf at a time during scans. Both are only for indexes without INCLUDE or
+   * trailing key attributes.
+   */
+  LeafFormat leafFormat = SLOTTEDLEAF;
+
+  /**
+   * Keep a blocked Bloom filter of the keys in pages of the index file. Point lookups, batch probes and
+   * equality scans check it first and skip the tree for keys that are definitely absent. Every insert
+   * updates one filter page; the filter is rebuilt twice as large when the index outgrows it.
+   */
+  bool bloomFilter = false;
+
+  /**
+   * Route point lookups and batch probes through piecewise linear models of the leaf order instead of
+   * the internal nodes, which suits keys as regular as sequential ids. The models live in memory only and
+   * are not recorded in the meta page; they are trained when the index is opened and retrained segment
+   * by segment as leaves split.
+   */
+  bool learnedRouting = false;
+
+  /**
+   * Number of inserts held in memory before they are sorted and applied to the leaves together, so that
+   * inserts in random key order touch each leaf once per batch instead of once per entry. Lookups check
+   * the held entries too, and a scan applies them before it starts. 0 applies every insert right away.
+   * Not recorded in the meta page; the destructor applies whatever is held.
+   */
+  int insertBufferSize = 0;
+};
+
+/**
+ * @brief One piece of the learned routing layer. It predicts the position of a leaf in the leaf chain
+ * from a key, for the numFences leaves starting at position firstFence, within LEARNEDERRORBOUND.
+ */
+struct LearnedSegment{
+  /**
+   * Fence key of the first leaf of the segment.
+   */
+  int firstKey;
+
+  /**
+   * Position of the first leaf of the segment in the leaf chain.
+   */
+  int firstFence;
+
+  /**
+   * Number of leaves the segment covers.
+   */
+  int numFences;
+
+  /**
+   * Leaves per key unit.
+   */
+  double slope;
+};
+
+/**
+ * @brief Operations of an index that are traced.
+ */
+enum TracedOperation
+{
+  TRACEINSERT,
+  TRACELOOKUP,
+  TRACESCAN
+};
+
+/**
+ * @brief A page read by a traced operation.
+ */
+struct PageAccess{
+  /**
+   * Page number in the index file.
+   */
+  PageId pageNo;
+
+  /**
+   * Level of the page: 0 for leaves, the level of the node for non-leaf nodes, -1 for posting list
+   * overflow pages.
+   */
+  int level;
+
+  /**
+   * True if the page was not in the buffer pool.
+   */
+  bool miss;
+};
+
+/**
+ * @brief Trace of one operation on an index: the pages it read in order, and what it cost.
+ */
+struct OperationTrace{
+  TracedOperation op;
+
+  /**
+   * Key inserted or looked up, the start key of a scan or the first key of a batch probe.
+   */
+  int key;
+
+  std::vector<PageAccess> pages;
+
+  /**
+   * Number of nodes split by the operation, at any level.
+   */
+  int splits;
+
+  /**
+   * Number of key comparisons in the non-leaf nodes passed.
+   */
+  int comparisons;
+
+  /**
+   * Number of pages read that were not in the buffer pool.
+   */
+  int bufferMisses;
+};
+
+/**
+ * @brief Counters an index keeps about its operations, always, whether or not tracing is compiled in.
+ */
+struct IndexCounters{
+  std::uint64_t inserts;
+  std::uint64_t lookups;
+  std::uint64_t scans;
+
+  /**
+   * Number of walks from the root to a leaf.
+   */
+  std::uint64_t descents;
+
+  /**
+   * Number of leaf contents kept for snapshots before a change.
+   */
+  std::uint64_t leafVersions;
+
+  /**
+   * Number of node splits per level, 0 for leaves.
+   */
+  std::uint64_t splitsByLevel[MAXTREEHEIGHT];
+};
+
+/**
+ * @brief Key range of an ascending scan, one of the parts BTreeIndex::splitScanRange cuts a range into.
+ * Scanned with a ScanCursor.
+ */
+struct ScanRange{
+  /**
+   * False if the range starts at the smallest key, otherwise lowVal and lowOp (GT or GTE) bound it.
+   */
+  bool lowBounded;
+  int lowVal;
+  Operator lowOp;
+
+  /**
+   * False if the range runs up to the largest key, otherwise highVal and highOp (LT or LTE) bound it.
+   */
+  bool highBounded;
+  int highVal;
+  Operator highOp;
+
+  /**
+   * Number of entries the range is expected to hold, from the number of subtrees it covers.
+   */
+  std::uint64_t estimatedEntries;
+};
+
+/**
+ * @brief Entries a leaf had before it was changed while snapshots were in use, kept for the snapshots
+ * taken before the change.
+ */
+struct LeafVersion{
+  /**
+   * Epoch of the change: snapshots of earlier epochs see these entries instead of the leaf.
+   */
+  std::uint64_t epoch;
+
+  /**
+   * Right sibling of the leaf before the change.
+   */
+  PageId rightSibPageNo;
+
+  std::vector<int> keys;
+  std::vector<RecordId> rids;
+};
+
+/**
+ * @brief Split that created a leaf while snapshots were in use.
+ */
+struct LeafOrigin{
+  /**
+   * Epoch of the split: snapshots of earlier epochs find the entries of the new leaf in the leaf split.
+   */
+  std::uint64_t epoch;
+  PageId splitPageNo;
+};
+
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
  * add to or make changes to the leaf node pages of the tree. Is templated for the key member.
@@ -81,6 +456,10 @@ class PageKeyPair{
 public:
   PageId pageNo;
   T key;
+  /**
+   * Bytes of the trailing key attributes when the index has a composite key.
+   */
+  char keySuffix[MAXKEYSUFFIXSIZE];
   void set( int p, T k)
   {
     pageNo = p;
@@ -135,6 +514,97 @@ struct IndexMetaInfo{
   * Tells whether or not the root is a leaf node or not
   */
   bool rootIsLeaf;
+
+  /**
+   * Version of the index format, INDEXFORMATVERSION at the time the file was created.
+   */
+  int formatVersion;
+
+  /**
+   * Number of levels in the tree including the leaf level. A tree whose root is a leaf has height 1.
+   */
+  int height;
+
+  /**
+   * Number of entries (key, rid pairs) stored in the leaves.
+   */
+  std::uint64_t numEntries;
+
+  /**
+   * Number of leaf pages in the tree.
+   */
+  int numLeafPages;
+
+  /**
+   * Number of non-leaf pages in the tree.
+   */
+  int numInternalPages;
+
+  /**
+   * Smallest key in the index. Only meaningful when numEntries > 0.
+   */
+  int minKey;
+
+  /**
+   * Largest key in the index. Only meaningful when numEntries > 0.
+   */
+  int maxKey;
+
+  /**
+   * Page number of the leftmost leaf. Leaf splits always move entries to a new right sibling,
+   * so this page stays the first leaf for the lifetime of the index.
+   */
+  PageId firstLeafPageNo;
+
+  /**
+   * Page number of the rightmost leaf. Changes whenever the rightmost leaf is split.
+   */
+  PageId lastLeafPageNo;
+
+  /**
+   * Number of INCLUDE attributes stored in the leaves.
+   */
+  int numIncludeAttrs;
+
+  /**
+   * INCLUDE attributes stored in the leaves, in the order their bytes appear in an entry's payload.
+   */
+  AttrDesc includeAttrs[MAXINCLUDEATTRS];
+
+  /**
+   * Number of key attributes following the leading one, 0 unless the key is composite.
+   */
+  int numTrailingKeyAttrs;
+
+  /**
+   * Key attributes following the leading one, in comparison order.
+   */
+  AttrDesc trailingKeyAttrs[MAXTRAILINGKEYATTRS];
+
+  /**
+   * Layout of the leaf pages.
+   */
+  LeafFormat leafFormat;
+
+  /**
+   * Number of overflow pages holding the rids of long posting lists.
+   */
+  int numOverflowPages;
+
+  /**
+   * True if the index keeps a Bloom filter.
+   */
+  bool bloomFilter;
+
+  /**
+   * Number of pages of the Bloom filter, 0 until the filter has been built.
+   */
+  int numBloomPages;
+
+  /**
+   * Pages of the Bloom filter, in block order.
+   */
+  PageId bloomPageNos[MAXBLOOMPAGES];
 };
 
 /*
@@ -146,6 +616,9 @@ at this level are just above the leaf nodes. Otherwise set to 0.
 
 /**
  * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+ * This is the layout of an index with a single key attribute. With a composite key a node holds fewer
+ * separators, its page numbers follow the first BTreeIndex::nodeOccupancy keys and the separators' key
+ * suffixes follow the page numbers; use BTreeIndex::nodePageNos() and BTreeIndex::nodeSuffix() to reach them.
 */
 struct NonLeafNodeInt{
   /**
@@ -167,6 +640,11 @@ struct NonLeafNodeInt{
 
 /**
  * @brief Structure for all leaf nodes when the key is of INTEGER type.
+ * This is the layout of an index without INCLUDE attributes. A covering index holds fewer entries per leaf
+ * and keeps the rids and the payload bytes of its entries in arrays that follow the first
+ * BTreeIndex::leafOccupancy keys; use BTreeIndex::leafRids() and BTreeIndex::leafPayload() to reach them.
+ * With a composite key, each entry's key suffix is stored right before its payload (BTreeIndex::leafSuffix()).
+ * The sibling pointers are at the end of the page for every index.
 */
 struct LeafNodeInt{
   /**
@@ -184,15 +662,166 @@ struct LeafNodeInt{
    * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
    */
   PageId rightSibPageNo;
-};
 
+  /**
+   * Page number of the leaf on the left side, used by descending scans.
+   */
+  PageId leftSibPageNo;
+};
+
+
+/**
+ * @brief Structure for leaf nodes of an index with the POSTINGLEAF format.
+ * The data area holds the posting lists of the leaf back to back, ordered by key. A posting list is the key,
+ * the number of rids shifted left by one with the low bit set if the rids are in overflow pages, and then
+ * either the number of bytes of the rids followed by the rids, or the first and last overflow page numbers.
+ * The counts are varints. Rids are sorted; each one stores the difference to the previous page number and
+ * either the slot number or, on the same page, the difference to the previous slot number, all as varints.
+ * A key is never split between two leaves.
+ * The sibling pointers are at the same place as in LeafNodeInt, so code that only follows the leaf chain
+ * can treat every leaf as a LeafNodeInt.
+*/
+struct PostingLeafNodeInt{
+  /**
+   * Number of posting lists, i.e. distinct keys, in the leaf.
+   */
+  int numKeys;
+
+  /**
+   * Number of bytes of data used by the posting lists.
+   */
+  int numBytes;
+
+  /**
+   * Posting lists.
+   */
+  char data[ POSTINGLEAFDATASIZE ];
+
+  /**
+   * Page number of the leaf on the right side.
+   */
+  PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side.
+   */
+  PageId leftSibPageNo;
+};
+
+
+/**
+ * @brief Structure for leaf nodes of an index with the COMPRESSEDLEAF format.
+ * Keys, rid page numbers and rid slot numbers are stored as unsigned offsets from the smallest value of
+ * their kind in the leaf (frame of reference), in three arrays of keyWidth, pageWidth and slotWidth bytes
+ * per entry. A width is the smallest of 0, 1, 2 and 4 bytes that holds the spread of the values and is
+ * chosen again whenever the leaf is written. Each array starts at a multiple of 4 bytes into data.
+ * Entries are in key order, duplicates in insertion order, as in LeafNodeInt.
+ * The sibling pointers are at the same place as in LeafNodeInt.
+*/
+struct CompressedLeafNodeInt{
+  /**
+   * Number of entries in the leaf.
+   */
+  int numEntries;
+
+  /**
+   * Smallest key, the first one.
+   */
+  int baseKey;
+
+  /**
+   * Smallest rid page number.
+   */
+  PageId basePageNo;
+
+  /**
+   * Smallest rid slot number.
+   */
+  SlotId baseSlotNo;
+
+  /**
+   * Bytes per entry of the key, page number and slot number arrays.
+   */
+  unsigned char keyWidth;
+  unsigned char pageWidth;
+  unsigned char slotWidth;
+
+  /**
+   * Padding, keeps data aligned.
+   */
+  unsigned char unused[3];
+
+  /**
+   * Key offsets, page number offsets and slot number offsets.
+   */
+  char data[ COMPRESSEDLEAFDATASIZE ];
+
+  /**
+   * Page number of the leaf on the right side.
+   */
+  PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side.
+   */
+  PageId leftSibPageNo;
+};
+
+
+/**
+ * @brief Structure for the overflow pages of a posting list. The pages of a list form a doubly linked chain
+ * in rid order; each holds a run of the rids, encoded as in a posting leaf.
+*/
+struct PostingOverflowNode{
+  /**
+   * Page number of the next overflow page of the list, 0 for the last one.
+   */
+  PageId nextPageNo;
+
+  /**
+   * Page number of the previous overflow page of the list, 0 for the first one.
+   */
+  PageId prevPageNo;
+
+  /**
+   * Number of rids in this page.
+   */
+  int numRids;
+
+  /**
+   * Number of bytes of data used by the rids.
+   */
+  int numBytes;
+
+  /**
+   * Encoded rids.
+   */
+  char data[ OVERFLOWDATASIZE ];
+};
+
+
+/**
+ * @brief Hash of an integer key (the splitmix64 finalizer), used by the Bloom filter and by HashIndex.
+ * All 64 bits are well mixed, so either half can be used on its own.
+ */
+std::uint64_t hashKey(int key);
+
+
+class ScanCursor;
+class IndexSnapshot;
+class ProbeExecutor;
 
 /**
  * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
+ * relation. This index supports only one scan at a time; more scans of parts of a range can run
+ * side by side with ScanCursor.
 */
 class BTreeIndex {
 
+  friend class ScanCursor;
+  friend class IndexSnapshot;
+  friend class ProbeExecutor;
+
  private:
 
   /**
@@ -235,6 +864,99 @@ class BTreeIndex {
    */
   int     nodeOccupancy;
 
+  /**
+   * INCLUDE attributes stored in the leaves.
+   */
+  std::vector<AttrDesc> includeAttrs;
+
+  /**
+   * Number of payload bytes stored with every leaf entry, 0 for an index without INCLUDE attributes.
+   */
+  int     payloadSize;
+
+  /**
+   * Key attributes following the leading INTEGER attribute of a composite key.
+   */
+  std::vector<AttrDesc> trailingKeyAttrs;
+
+  /**
+   * Number of bytes of the trailing key attributes (the key suffix), 0 unless the key is composite.
+   */
+  int     keySuffixSize;
+
+  /**
+   * Comparison of two key suffixes, chosen when the index is opened. Common shapes get a comparison
+   * instantiated from a template; NULL means the suffix is compared attribute by attribute.
+   */
+  int     (*suffixCompare)(const char *suffix1, const char *suffix2);
+
+  /**
+   * Layout of the leaf pages.
+   */
+  LeafFormat leafFormat;
+
+  /**
+   * Rids of a posting list or an overflow page being modified by an insert.
+   */
+  std::vector<RecordId> postingRids;
+
+  /**
+   * Entries of a compressed leaf being modified by an insert.
+   */
+  std::vector<int> compressedKeys;
+  std::vector<RecordId> compressedRids;
+
+  /**
+   * True if the index keeps a Bloom filter.
+   */
+  bool    bloomFilter;
+
+  /**
+   * Pages of the Bloom filter, empty until the filter has been built.
+   */
+  std::vector<PageId> bloomPageNos;
+
+  /**
+   * Keys of a leaf returned by getLeafKeys() for leaves whose keys have to be decoded.
+   */
+  std::vector<int> leafKeyBuffer;
+
+  /**
+   * True if point lookups go through the learned routing layer.
+   */
+  bool learnedRouting;
+
+  /**
+   * Fence key of every leaf in chain order, the separator that routes keys to it. Every key of the leaf
+   * before is at most the fence, every key of the leaf at least the fence.
+   */
+  std::vector<int> fenceKeys;
+
+  /**
+   * Page number of every leaf in chain order.
+   */
+  std::vector<PageId> fencePageNos;
+
+  /**
+   * Segments of the learned routing layer, ordered by firstKey and together covering all fences.
+   */
+  std::vector<LearnedSegment> learnedSegments;
+
+  /**
+   * Number of inserts held in insertBuffer before they are applied, 0 if inserts are applied right away.
+   */
+  int     insertBufferSize;
+
+  /**
+   * Entries inserted but not yet applied to the leaves, in key order, ties in rid order.
+   */
+  std::vector<RIDKeyPair<int> > insertBuffer;
+
+  /**
+   * Key suffix and payload bytes of the entries in insertBuffer, keySuffixSize + payloadSize per entry.
+   */
+  std::vector<char> insertBufferBytes;
+
 
   // MEMBERS SPECIFIC TO SCANNING
 
@@ -243,11 +965,70 @@ class BTreeIndex {
    */
   bool    scanExecuting;
 
+  /**
+   * Direction of the scan. Descending scans start at the high value and walk the leftSibPageNo chain.
+   */
+  ScanDirection scanDirection;
+
   /**
    * Index of next entry to be scanned in current leaf being scanned.
    */
   int     nextEntry;
 
+  /**
+   * Keys of the entries of the current leaf. Points into the leaf itself for slotted leaves and into
+   * scanKeyBuffer for leaves that have to be decoded.
+   */
+  const int *scanKeys;
+
+  /**
+   * Rids of the entries of the current leaf, next to scanKeys. A rid with page number 0 stands for a
+   * posting list in overflow pages; its slot number indexes scanOverflowLists.
+   */
+  const RecordId *scanRids;
+
+  /**
+   * Number of entries of the current leaf.
+   */
+  int     scanCount;
+
+  /**
+   * Decoded keys of the current leaf.
+   */
+  std::vector<int> scanKeyBuffer;
+
+  /**
+   * Decoded rids of the current leaf.
+   */
+  std::vector<RecordId> scanRidBuffer;
+
+  /**
+   * First and last overflow page of every posting list of the current leaf that is stored in overflow pages.
+   */
+  std::vector<std::pair<PageId, PageId> > scanOverflowLists;
+
+  /**
+   * Overflow page whose rids are being scanned, 0 while the scan is not inside an overflow posting list.
+   */
+  PageId  overflowPageNum;
+
+  /**
+   * Overflow pages before and after overflowPageNum in its list.
+   */
+  PageId  overflowPrevPageNum;
+  PageId  overflowNextPageNum;
+
+  /**
+   * Decoded rids of overflowPageNum. The page itself is not kept pinned.
+   */
+  std::vector<RecordId> overflowRidBuffer;
+
+  /**
+   * Number of rids of overflowPageNum, and index of the next one to be scanned.
+   */
+  int     overflowCount;
+  int     overflowEntry;
+
   /**
    * Page number of current page being scanned.
    */
@@ -298,109 +1079,914 @@ class BTreeIndex {
    */
   Operator  highOp;
 
-  std::vector<PageId> pagesAccessed{};
+  /**
+   * False if the scan was started without a low value, i.e. it starts at the smallest key.
+   */
+  bool    lowBounded;
 
+  /**
+   * False if the scan was started without a high value, i.e. it runs up to the largest key.
+   */
+  bool    highBounded;
 
-  bool isRootLeaf;
+  /**
+   * Held by every user of the buffer pool that may run beside others, since the buffer pool is not thread
+   * safe: inserts and lookups for the whole operation, ScanCursors and the workers of a ProbeExecutor for
+   * one descent and run of leaves at a time. Recursive because inserts can apply the insert buffer.
+   */
+  std::recursive_mutex bufferLatch;
 
+  // SNAPSHOTS
 
- public:
+  /**
+   * Current epoch. Taking a snapshot closes it: the snapshot sees the changes made up to its epoch and
+   * none made later. Guarded by bufferLatch, like the rest of the snapshot state.
+   */
+  std::uint64_t epoch;
 
   /**
-   * BTreeIndex Constructor. 
-   * Check to see if the corresponding index file exists. If so, open the file.
-   * If not, create it and insert entries for every tuple in the base relation using FileScan class.
-   *
-   * @param relationName        Name of file.
-   * @param outIndexName        Return the name of index file.
-   * @param bufMgrIn            Buffer Manager Instance
-   * @param attrByteOffset      Offset of attribute, over which index is to be built, in the record
-   * @param attrType            Datatype of attribute over which index is built
+   * Epochs of the snapshots in use, one element per snapshot.
    */
-  BTreeIndex(const std::string & relationName, std::string & outIndexName,
-            BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType);
-  
+  std::multiset<std::uint64_t> activeSnapshots;
 
   /**
-   * BTreeIndex Destructor. 
-   * End any initialized scan, flush index file, after unpinning any pinned pages, from the buffer manager
-   * and delete file instance thereby closing the index file.
-   * Destructor should not throw any exceptions. All exceptions should be caught in here itself. 
-   * */
-  ~BTreeIndex();
+   * Former contents of leaves changed while snapshots were in use, by page number and in epoch order.
+   * A version is retired once every snapshot older than its epoch has ended.
+   */
+  std::map<PageId, std::vector<LeafVersion> > leafVersions;
 
+  /**
+   * Leaves created while snapshots were in use, by page number. Retired like the versions.
+   */
+  std::map<PageId, LeafOrigin> leafOrigins;
 
+  /**
+   * Close the current epoch and register a snapshot of it.
+   * @return  Epoch of the snapshot
+   */
+  std::uint64_t beginSnapshot();
 
+  /**
+   * Unregister a snapshot and retire the leaf versions and origins no remaining snapshot needs.
+   */
+  void endSnapshot(std::uint64_t snapshotEpoch);
 
+  /**
+   * Keep the entries of a leaf about to be changed if a snapshot in use has not seen a change to it yet.
+   */
+  void saveLeafVersion(Page *leafPage, PageId leafPageNum);
 
+  /**
+   * Record the leaf a split created and the leaf it split, if snapshots are in use.
+   */
+  void recordLeafOrigin(PageId newPageNum, PageId leafPageNum);
 
+  /**
+   * The leaf that held, at a snapshot, the entries a leaf found by a descent holds now: the leaf itself or
+   * the leaf it was split off from.
+   */
+  PageId snapshotLeaf(PageId leafPageNum, std::uint64_t snapshotEpoch);
 
+  /**
+   * Append the entries a leaf had at a snapshot, from its version for the snapshot or from the leaf if it
+   * has not changed since.
+   * @return  Right sibling of the leaf at the snapshot
+   */
+  PageId appendSnapshotEntries(PageId leafPageNum, std::uint64_t snapshotEpoch, std::vector<int> &keys, std::vector<RecordId> &rids);
 
+  // INSTRUMENTATION
 
-  void formNewRoot(PageId firstPageInRoot, PageKeyPair<int> *newchildEntry);
+  /**
+   * Operation counters, always kept.
+   */
+  IndexCounters counters;
 
-  void partitionInternalNode(NonLeafNodeInt *oldNode, PageId oldPageNum, PageKeyPair<int> *&newchildEntry);
+  /**
+   * Pages read so far by the operation being traced. Only filled when compiled with BTREETRACE.
+   */
+  std::vector<PageAccess> pagesAccessed{};
 
-  void partitionLeaf(LeafNodeInt *leaf, PageId leafPageNum, PageKeyPair<int> *&newchildEntry, const RIDKeyPair<int> dataEntry);
-  
-  void searchLevel(NonLeafNodeInt *curNode, PageId &nextNodeNum, int key);
+  /**
+   * The operation being traced, its key, and the splits and comparisons it made so far.
+   */
+  OperationTrace currentTrace;
 
-  void insertLeafNode(LeafNodeInt *leaf, RIDKeyPair<int> entry);
+  /**
+   * True between beginTrace and endTrace.
+   */
+  bool tracing;
 
-  void insertInternalNode(NonLeafNodeInt *nonleaf, PageKeyPair<int> *entry);
-  
-  void insertHelper(Page *curPage, PageId curPageNum, bool nodeIsLeaf, const RIDKeyPair<int> dataEntry, PageKeyPair<int> *&newchildEntry);
-  
- 
-  void findLeaf();
+  /**
+   * Disk reads of the buffer pool counted when the last traced page was read, to tell whether the next one missed.
+   */
+  std::uint64_t traceMissMark;
 
+  /**
+   * The last MAXTRACES finished traces, a ring starting at position numTraces % MAXTRACES once it is full.
+   */
+  std::vector<OperationTrace> traces;
 
   /**
-   * Insert a new entry using the pair <value,rid>. 
-   * Start from root to recursively find out the leaf to insert the entry in. The insertion may cause splitting of leaf node.
-   * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
-   * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
-   * Make sure to unpin pages as soon as you can.
-   * @param key     Key to insert, pointer to integer/double/char string
-   * @param rid     Record ID of a record whose entry is getting inserted into the index.
-  **/
-  void insertEntry(const void* key, const RecordId rid);
+   * Number of traces finished since the index was opened.
+   */
+  std::uint64_t numTraces;
 
+  /**
+   * Start tracing an operation, finishing the one being traced if any.
+   */
+  void beginTrace(TracedOperation op, int key);
 
   /**
-   * Begin a filtered scan of the index.  For instance, if the method is called 
-   * using ("a",GT,"d",LTE) then we should seek all entries with a value 
-   * greater than "a" and less than or equal to "d".
-   * If another scan is already executing, that needs to be ended here.
-   * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
-   * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
-   * @param lowVal  Low value of range, pointer to integer / double / char string
-   * @param lowOp   Low operator (GT/GTE)
-   * @param highVal High value of range, pointer to integer / double / char string
-   * @param highOp  High operator (LT/LTE)
-   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
-   * @throws  BadScanrangeException If lowVal > highval
-   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
-  **/
-  void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+   * Record a page the traced operation has just read.
+   */
+  void tracePage(PageId pageNo, int level);
 
+  /**
+   * Finish the trace of the current operation and keep it.
+   */
+  void endTrace();
 
   /**
-   * Fetch the record id of the next index entry that matches the scan.
-   * Return the next record from current page being scanned. If current page has been scanned to its entirety, move on to the right sibling of current page, if any exists, to start scanning that page. Make sure to unpin any pages that are no longer required.
-   * @param outRid  RecordId of next record found that satisfies the scan criteria returned in this
-   * @throws ScanNotInitializedException If no scan has been initialized.
+   * Ends the trace of an operation when it goes out of scope, also when the operation throws.
+   */
+  struct TraceScope{
+    BTreeIndex *index;
+    TraceScope(BTreeIndex *index, TracedOperation op, int key) : index(index) { index->beginTrace(op, key); }
+    ~TraceScope() { index->endTrace(); }
+  };
+
+
+  bool isRootLeaf;
+
+
+  // TREE STATISTICS, MIRRORED FROM THE META PAGE
+
+  /**
+   * Number of levels in the tree including the leaf level.
+   */
+  int     height;
+
+  /**
+   * Number of entries stored in the leaves.
+   */
+  std::uint64_t numEntries;
+
+  /**
+   * Number of leaf pages.
+   */
+  int     numLeafPages;
+
+  /**
+   * Number of non-leaf pages.
+   */
+  int     numInternalPages;
+
+  /**
+   * Smallest key inserted so far.
+   */
+  int     minKey;
+
+  /**
+   * Largest key inserted so far.
+   */
+  int     maxKey;
+
+  /**
+   * Page number of the leftmost leaf.
+   */
+  PageId  firstLeafPageNum;
+
+  /**
+   * Page number of the rightmost leaf.
+   */
+  PageId  lastLeafPageNum;
+
+  /**
+   * Number of posting list overflow pages.
+   */
+  int     numOverflowPages;
+
+  /**
+   * Copy the root page number and the tree statistics kept in this object into the meta page.
+   */
+  void writeMetaInfo();
+
+  /**
+   * Gather the INCLUDE attributes of a record of the base relation into a payload of payloadSize bytes.
+   */
+  void extractPayload(const char *record, char *payload);
+
+  /**
+   * Gather the key of a record of the base relation: the leading INTEGER followed by the key suffix.
+   */
+  void extractKey(const char *record, char *key);
+
+  /**
+   * True if both lists describe the same attributes.
+   */
+  static bool isSameAttrs(const AttrDesc *attrs1, int numAttrs1, const std::vector<AttrDesc> &attrs2);
+
+  /**
+   * Compare two keys, lexicographically on the leading INTEGER and then the key suffix.
+   * A NULL suffix compares only the leading INTEGER, which is what scans over a prefix range use.
+   * @return  Negative, zero or positive as the first key is smaller than, equal to or greater than the second
+   */
+  int compareKeys(int key1, const char *suffix1, int key2, const char *suffix2);
+
+  /**
+   * Compare two key suffixes attribute by attribute, for shapes without an instantiated comparison.
+   */
+  int compareSuffixByAttr(const char *suffix1, const char *suffix2);
+
+  /**
+   * Array of page numbers of a non-leaf node. It starts right after the nodeOccupancy keys.
+   */
+  PageId *nodePageNos(NonLeafNodeInt *node) { return (PageId *)(node->keyArray + nodeOccupancy); }
+
+  /**
+   * Key suffix of separator i of a non-leaf node. Suffixes follow the page number array.
+   */
+  char *nodeSuffix(NonLeafNodeInt *node, int i) { return (char *)(nodePageNos(node) + nodeOccupancy + 1) + i * keySuffixSize; }
+
+  /**
+   * Array of rids of a leaf. It starts right after the leafOccupancy keys, so its position depends on the
+   * payload size of the index.
+   */
+  RecordId *leafRids(LeafNodeInt *leaf) { return (RecordId *)(leaf->keyArray + leafOccupancy); }
+
+  /**
+   * Key suffix of the entry in slot i of a leaf. Each entry's key suffix and payload follow the rid array.
+   */
+  char *leafSuffix(LeafNodeInt *leaf, int i) { return (char *)(leafRids(leaf) + leafOccupancy) + i * (keySuffixSize + payloadSize); }
+
+  /**
+   * Payload bytes of the entry in slot i of a leaf, right after its key suffix.
+   */
+  char *leafPayload(LeafNodeInt *leaf, int i) { return leafSuffix(leaf, i) + keySuffixSize; }
+
+
+ public:
+
+  /**
+   * BTreeIndex Constructor. 
+   * Check to see if the corresponding index file exists. If so, open the file.
+   * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file. It holds the offsets of the key, trailing key and
+   *                            INCLUDE attributes and the leaf format, so that each kind of index has its own file.
+   * @param bufMgrIn            Buffer Manager Instance
+   * @param attrByteOffset      Offset of attribute, over which index is to be built, in the record
+   * @param attrType            Datatype of attribute over which index is built
+   * @param options             Optional settings of the index, such as INCLUDE attributes or trailing key attributes
+   * @throws  BadIndexInfoException If an existing index file was built differently, or the options are invalid
+   */
+  BTreeIndex(const std::string & relationName, std::string & outIndexName,
+            BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType,
+            const IndexOptions &options = IndexOptions());
+  
+
+  /**
+   * BTreeIndex Destructor. 
+   * End any initialized scan, flush index file, after unpinning any pinned pages, from the buffer manager
+   * and delete file instance thereby closing the index file.
+   * Destructor should not throw any exceptions. All exceptions should be caught in here itself. 
+   * */
+  ~BTreeIndex();
+
+
+
+
+
+
+
+
+
+  void formNewRoot(PageId firstPageInRoot, const PageKeyPair<int> &newchildEntry);
+
+  void partitionInternalNode(NonLeafNodeInt *oldNode, PageId oldPageNum, PageId splitChildNum, PageKeyPair<int> &newchildEntry);
+
+  void partitionLeaf(LeafNodeInt *leaf, PageId leafPageNum, PageKeyPair<int> &newchildEntry, const RIDKeyPair<int> dataEntry, const char *suffixAndPayload);
+
+  /**
+   * Link a leaf created by splitting leaf into the leaf chain, right after leaf.
+   */
+  void linkNewLeaf(LeafNodeInt *leaf, PageId leafPageNum, LeafNodeInt *newLeaf, PageId newPageNum, int newFirstKey);
+
+  /**
+   * Collect the fences of all leaves and train the learned routing layer over them.
+   */
+  void buildLearnedRouting();
+
+  /**
+   * Append the fences of the leaves below a non-leaf node, in chain order. The fence of a leaf is the
+   * separator left of it in its parent, or lowKey for the first child.
+   */
+  void collectFences(PageId pageNum, int lowKey);
+
+  /**
+   * Fit segments to the fences at positions first to first+num-1, each one keeping every fence within
+   * LEARNEDERRORBOUND of its prediction, and append them to segments.
+   */
+  void trainSegments(int first, int num, std::vector<LearnedSegment> &segments);
+
+  /**
+   * Add the fence of a leaf created by splitting another one, and retrain the segment it falls into.
+   */
+  void addLearnedFence(PageId leafPageNum, PageId newPageNum, int newFirstKey);
+
+  /**
+   * Predict the leaf a lookup of key has to start at with the learned routing layer.
+   * @return  False if the key falls outside the error bound of its segment
+   */
+  bool predictLeaf(int key, PageId &leafPageNum);
+
+  /**
+   * Pin the leaf a lookup of key has to start at, predicted by the learned routing layer if possible and
+   * found by descending from the root otherwise.
+   */
+  void routeToLeaf(int key, PageId &leafPageNum, Page *&leafPage);
+
+  /**
+   * Insert an entry into a posting leaf, adding the rid to the posting list of its key. The leaf is split
+   * between two posting lists if it runs out of room. Unpins the leaf.
+   * @param leaf            Posting leaf the key belongs to
+   * @param leafPageNum     Page number of leaf
+   * @param dataEntry       Entry to insert
+   * @param newchildEntry   Set to the separator of the new leaf if the leaf was split, its pageNo to 0 otherwise
+   */
+  void insertPostingLeaf(PostingLeafNodeInt *leaf, PageId leafPageNum, const RIDKeyPair<int> dataEntry, PageKeyPair<int> &newchildEntry);
+
+  /**
+   * Insert an entry into a compressed leaf. The leaf is decoded, the entry added after any entries with
+   * the same key and the leaf encoded again, with wider offsets if needed. A leaf that no longer fits or
+   * has COMPRESSEDLEAFMAXENTRIES entries is split in the middle. Unpins the leaf.
+   * @param leaf            Compressed leaf the key belongs to
+   * @param leafPageNum     Page number of leaf
+   * @param dataEntry       Entry to insert
+   * @param newchildEntry   Set to the separator of the new leaf if the leaf was split, its pageNo to 0 otherwise
+   */
+  void insertCompressedLeaf(CompressedLeafNodeInt *leaf, PageId leafPageNum, const RIDKeyPair<int> dataEntry, PageKeyPair<int> &newchildEntry);
+
+  /**
+   * Insert a rid into a posting list stored in overflow pages, splitting the overflow page it falls in when
+   * that page is full.
+   * @param tailPageNo  Last overflow page of the list, updated if a new last page is added
+   * @param rid         Rid to insert
+   */
+  void insertOverflowRid(PageId &tailPageNo, RecordId rid);
+
+  /**
+   * Move the rids of a posting list into a new overflow page.
+   * @return  Page number of the overflow page
+   */
+  PageId createOverflowList(const RecordId *rids, int numRids);
+  
+  /**
+   * Find the child of a non-leaf node to descend into for the given key.
+   * @param curNode       Non-leaf node to search
+   * @param nextNodeNum   Page number of the child is returned in this
+   * @param key           Key to search for
+   * @param toRight       If true, pick the rightmost child that can hold key instead of the leftmost one.
+   *                      Descending scans with an LTE high value use this to land on the last copy of a key.
+   * @param keySuffix     Key suffix of a composite key. NULL searches on the leading INTEGER only.
+   */
+  void searchLevel(NonLeafNodeInt *curNode, PageId &nextNodeNum, int key, bool toRight = false, const char *keySuffix = NULL);
+
+  /**
+   * Number of entries in a leaf. Entries are kept at the front of the leaf, an unused slot has a rid
+   * with page number 0.
+   */
+  int getLeafEntryCount(LeafNodeInt *leaf);
+
+  void insertLeafNode(LeafNodeInt *leaf, RIDKeyPair<int> entry, const char *suffixAndPayload);
+
+  /**
+   * Insert the separator produced by splitting a child into a non-leaf node that has room for it.
+   * The position is taken from the child rather than from the key: with duplicate keys several
+   * separators can be equal, and the new page has to end up right after the page it was split from.
+   * @param nonleaf         Non-leaf node to insert into
+   * @param splitChildNum   Page number of the child that was split, must be a child of nonleaf
+   * @param entry           Separator key and page number of the new right half of the child
+   */
+  void insertInternalNode(NonLeafNodeInt *nonleaf, PageId splitChildNum, const PageKeyPair<int> &entry);
+  
+  /**
+   * Insert an entry into a leaf of any format, splitting it if needed. Unpins the leaf.
+   * @param newchildEntry   Set to the separator and page number of the new right sibling of the leaf if
+   *                        it was split, its pageNo to 0 otherwise. Owned by the caller, so split results
+   *                        pass up without any allocation.
+   */
+  void insertIntoLeaf(Page *leafPage, PageId leafPageNum, const RIDKeyPair<int> dataEntry, const char *suffixAndPayload, PageKeyPair<int> &newchildEntry);
+
+  /**
+   * Insert an entry into the tree. The descent from the root pins one node at a time and records the
+   * path; only the nodes a split has to change are pinned again on the way back up.
+   */
+  void insertIntoTree(const RIDKeyPair<int> dataEntry, const char *suffixAndPayload);
+
+  /**
+   * Update the minimum, maximum and entry count for an inserted key.
+   */
+  void addToStats(int key);
+
+  /**
+   * Add an inserted key to the Bloom filter if the index keeps one, rebuilding the filter larger once
+   * the index has outgrown it.
+   */
+  void updateBloomFilter(int key);
+
+  /**
+   * Merge entries in key order into a slotted leaf with room for all of them. Equal keys go after the
+   * entries already there.
+   */
+  void mergeIntoLeaf(LeafNodeInt *leaf, const RIDKeyPair<int> *entries, int num);
+
+  /**
+   * Add an entry to insertBuffer where it belongs in key order, after the entries it ties with.
+   * @param dataEntry  Entry to add
+   * @param suffixAndPayload  keySuffixSize bytes of key suffix followed by payloadSize bytes of payload
+   */
+  void addToInsertBuffer(const RIDKeyPair<int> &dataEntry, const char *suffixAndPayload);
+
+  /**
+   * Look for a key among the entries of insertBuffer.
+   * @return  True if an entry with the key is held
+   */
+  bool searchInsertBuffer(int key, RecordId &outRid);
+  
+ 
+  /**
+   * Position the scan on the first entry that satisfies the scan criteria. Scans without a start value
+   * (the low value for ascending scans, the high value for descending ones) start at the first or last
+   * leaf recorded in the meta page, otherwise the tree is descended from the root using the start value.
+   * The leaf holding the first matching entry stays pinned.
+   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+   */
+  void findLeaf();
+
+  /**
+   * Make nextEntry point to a valid entry, moving to the next leaf in scan direction (and unpinning
+   * the current leaf) when the current leaf has been scanned in its entirety.
+   * @return  False if there are no entries left in the leaf chain.
+   */
+  bool moveToValidEntry();
+
+  /**
+   * True if key lies beyond the end of the scan range in scan direction, i.e. above the high value
+   * of an ascending scan or below the low value of a descending one.
+   */
+  bool isPastScanEnd(int key);
+
+  /**
+   * Pin the Bloom filter page holding the block of a key hash.
+   * @return  The block as 64 bit words
+   */
+  std::uint64_t *readBloomBlock(std::uint64_t hash, PageId &pageNum);
+
+  /**
+   * Set the bits of a key in the Bloom filter.
+   */
+  void addToBloomFilter(int key);
+
+  /**
+   * Replace the Bloom filter by one sized for twice the current number of entries and add the keys of
+   * all leaves to it.
+   */
+  void buildBloomFilter();
+
+  /**
+   * Keys of a leaf in order, one per posting list for posting leaves.
+   * @return  Pointer into the leaf or into leafKeyBuffer, valid until the next call
+   */
+  const int *getLeafKeys(Page *leafPage, int &numKeys);
+
+  /**
+   * Rid of the entry at position i of the keys returned by getLeafKeys(), the first rid of the posting
+   * list for posting leaves.
+   */
+  RecordId getLeafRid(Page *leafPage, int i);
+
+  /**
+   * Descend from the root to the leaf an entry with the given key is in, if there is one. The leaf is pinned.
+   */
+  void descendToLeaf(int key, PageId &leafPageNum, Page *&leafPage);
+
+  /**
+   * Look for a key, starting from a leaf kept pinned by earlier probes if the key lies within its keys and
+   * descending the tree otherwise. The leaf the key was looked up in stays pinned.
+   * @param key           Key to look for
+   * @param leafPageNum   Pinned leaf, 0 if there is none. Updated to the leaf left pinned.
+   * @param leafPage      Pinned leaf
+   * @param leafKeys      Keys of the pinned leaf, from getLeafKeys()
+   * @param numLeafKeys   Number of keys of the pinned leaf
+   * @param outRid        Rid of an entry with the key if found
+   * @return  True if the key was found
+   */
+  bool probeLeaf(int key, PageId &leafPageNum, Page *&leafPage, const int *&leafKeys, int &numLeafKeys, RecordId &outRid);
+
+  /**
+   * Set scanKeys, scanRids and scanCount for the leaf in currentPageData, decoding it if needed.
+   */
+  void loadLeaf();
+
+  /**
+   * Decode an overflow page of the posting list being scanned into overflowRidBuffer and position the
+   * scan on its first rid in scan direction.
+   */
+  void loadOverflowPage(PageId pageNum);
+
+  /**
+   * Append the entries of a leaf of any format to keys and rids, in order. The rids of posting lists in
+   * overflow pages are read from those pages.
+   */
+  void appendLeafEntries(Page *leafPage, std::vector<int> &keys, std::vector<RecordId> &rids);
+
+  /**
+   * Rid of the entry the scan is positioned on.
+   */
+  RecordId scanRid() const { return overflowPageNum != 0 ? overflowRidBuffer[overflowEntry] : scanRids[nextEntry]; }
+
+  /**
+   * Move the scan to the next entry in scan direction.
+   */
+  void advanceScan()
+  {
+    int step = scanDirection == DESCENDING ? -1 : 1;
+    if (overflowPageNum != 0)
+    {
+      overflowEntry += step;
+    }
+    else
+    {
+      nextEntry += step;
+    }
+  }
+
+  /**
+   * Move the scan past all entries with the key it is positioned on that are in the same leaf slot,
+   * i.e. past one entry, or past a whole posting list stored in overflow pages.
+   */
+  void skipScanKey()
+  {
+    overflowPageNum = 0;
+    nextEntry += scanDirection == DESCENDING ? -1 : 1;
+  }
+
+
+  /**
+   * Insert a new entry using the pair <value,rid>. 
+   * Start from root to recursively find out the leaf to insert the entry in. The insertion may cause splitting of leaf node.
+   * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
+   * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
+   * Make sure to unpin pages as soon as you can.
+   * @param key     Key to insert, pointer to integer/double/char string. For a composite key, the leading
+   *                INTEGER immediately followed by the values of the trailing key attributes.
+   * @param rid     Record ID of a record whose entry is getting inserted into the index.
+   * @param payload Values of the INCLUDE attributes, getPayloadSize() bytes laid out in the order the attributes
+   *                were given. NULL stores zeros. Ignored for an index without INCLUDE attributes.
+  **/
+  void insertEntry(const void* key, const RecordId rid, const void* payload = NULL);
+
+  /**
+   * Insert many entries at once. The entries are sorted if they are not in key order already. Every
+   * leaf they go to is reached with one descent, and all entries that belong to it and fit are added
+   * in one go before moving on. A full leaf that is appended to past the largest key keeps
+   * APPENDSPLITPERCENT percent of its entries when it splits, so ascending batches leave nearly full leaves.
+   * @param entries  Entries to insert, the key being the whole key of the index
+   * @param n        Number of entries
+   * @throws  BadIndexInfoException If the index has a composite key, whose trailing attributes the entries lack
+   */
+  void insertBatch(const RIDKeyPair<int>* entries, size_t n);
+
+  /**
+   * Apply the inserts held in memory to the leaves, in key order. Does nothing unless the index was
+   * created with IndexOptions::insertBufferSize.
+   */
+  void flushInsertBuffer();
+
+
+  /**
+   * Check the Bloom filter for a key. Holds bufferLatch, so it may run beside inserts.
+   * @param key  Key, pointer to integer. The leading INTEGER for a composite key.
+   * @return  False if the index definitely has no entry with the key. Always true without a Bloom filter.
+   */
+  bool mayContainKey(const void* key);
+
+  /**
+   * Look up one entry with the given key, without disturbing a scan in progress. Keys the Bloom filter
+   * rules out are answered without touching the tree. Holds bufferLatch, so it may run beside inserts.
+   * @param key     Key, pointer to integer. The leading INTEGER for a composite key.
+   * @param outRid  Rid of an entry with the key, the first one in key order, if found
+   * @return  True if the index has an entry with the key
+   */
+  bool lookupEntry(const void* key, RecordId& outRid);
+
+  /**
+   * Look up many keys at once. Keys ruled out by the Bloom filter are dropped, the others are probed in
+   * key order so that keys falling into the same leaf share one descent of the tree. Holds bufferLatch,
+   * so it may run beside inserts.
+   * @param keys      Keys to look up
+   * @param numKeys   Number of keys
+   * @param outRids   Receives, for every key found, the rid of an entry with the key
+   * @param outFound  Receives for every key whether it was found
+   * @return  Number of keys found
+   */
+  int probeBatch(const int* keys, const int numKeys, RecordId* outRids, bool* outFound);
+
+
+  /**
+   * Begin a filtered scan of the index.  For instance, if the method is called 
+   * using ("a",GT,"d",LTE) then we should seek all entries with a value 
+   * greater than "a" and less than or equal to "d".
+   * If another scan is already executing, that needs to be ended here.
+   * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
+   * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
+   * Either bound may be left open by passing NULL as its value, in which case the corresponding operator
+   * is ignored. A scan with both values NULL is a full ordered pass over the index; scans without a low
+   * value start directly at the leftmost leaf instead of descending the tree.
+   * An equality scan (GTE and LTE on the same value) of a key ruled out by the Bloom filter fails without
+   * touching the tree.
+   * On a composite key the values bound the leading INTEGER attribute only (a prefix range); matching
+   * entries come back ordered on the whole key.
+   * A DESCENDING scan returns the same entries from the largest key down: it starts at the high value
+   * (LT/LTE), or directly at the rightmost leaf when there is no high value, and follows left siblings.
+   * The scan keeps its leaf pinned between calls without holding bufferLatch, so from startScan to endScan
+   * the index must not be changed; use a ScanCursor to scan beside inserts.
+   * @param lowVal  Low value of range, pointer to integer / double / char string, or NULL for no low bound
+   * @param lowOp   Low operator (GT/GTE)
+   * @param highVal High value of range, pointer to integer / double / char string, or NULL for no high bound
+   * @param highOp  High operator (LT/LTE)
+   * @param direction  ASCENDING or DESCENDING key order
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+  **/
+  void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+                 const ScanDirection direction = ASCENDING);
+
+
+  /**
+   * Fetch the record id of the next index entry that matches the scan.
+   * Return the next record from current page being scanned. If current page has been scanned to its entirety, move on to the right sibling of current page (the left sibling for descending scans), if any exists, to start scanning that page. Make sure to unpin any pages that are no longer required.
+   * @param outRid  RecordId of next record found that satisfies the scan criteria returned in this
+   * @throws ScanNotInitializedException If no scan has been initialized.
    * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
   **/
   void scanNext(RecordId& outRid);  // returned record id
 
 
+  /**
+   * Fetch the next batch of index entries that match the scan, together with their keys.
+   * Queries that only need the indexed attribute can use the keys directly instead of reading the
+   * records from the base relation. Entries are copied out of the leaves one leaf at a time, so a
+   * batch costs one buffer access per leaf rather than one call per entry.
+   * @param outPairs  Array of at least maxPairs entries, filled with the (rid, key) pairs in scan order
+   * @param maxPairs  Maximum number of pairs to return
+   * @param outPayloads  If not NULL, receives getPayloadSize() bytes of INCLUDE attributes for every returned
+   *                     pair, back to back. Must have room for maxPairs payloads.
+   * @param outKeySuffixes  If not NULL, receives getKeySuffixSize() bytes of trailing key attributes for every
+   *                        returned pair, back to back. The pairs only hold the leading INTEGER of the key.
+   * @return  Number of pairs returned, at least 1
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   * @throws BadScanrangeException If maxPairs is not positive.
+   * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+  **/
+  int scanNextBatch(RIDKeyPair<int>* outPairs, const int maxPairs, char* outPayloads = NULL, char* outKeySuffixes = NULL);
+
+
   /**
    * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
    * @throws ScanNotInitializedException If no scan has been initialized.
   **/
   void endScan();
-  
+
+
+  /**
+   * Cut the range of an ascending scan into at most numRanges consecutive sub-ranges of about the same
+   * number of entries, to be scanned in parallel with one ScanCursor each. The cuts are separator keys of
+   * the highest level of the tree with at least SPLITOVERSAMPLE subtrees per sub-range in the range (or
+   * of the level above the leaves), so every sub-range covers about the same number of subtrees. Only
+   * the non-leaf nodes overlapping the range on the levels down to that one are read.
+   * A range with too few subtrees, or too few distinct keys to cut at, comes back in fewer parts.
+   * @param lowVal      Low value of range, pointer to integer, or NULL for no low bound
+   * @param lowOp       Low operator (GT/GTE)
+   * @param highVal     High value of range, pointer to integer, or NULL for no high bound
+   * @param highOp      High operator (LT/LTE)
+   * @param numRanges   Number of sub-ranges wanted, typically the number of worker threads
+   * @param outRanges   Receives the sub-ranges in key order
+   * @return  Number of sub-ranges, at least 1
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+  **/
+  int splitScanRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+                     const int numRanges, std::vector<ScanRange>& outRanges);
+
+
+  /**
+   * Number of levels in the tree including the leaf level. A tree whose root is a leaf has height 1.
+   */
+  int getHeight() const { return height; }
+
+  /**
+   * Number of entries (key, rid pairs) in the index.
+   */
+  std::uint64_t getNumEntries() const { return numEntries; }
+
+  /**
+   * Number of leaf pages in the index.
+   */
+  int getNumLeafPages() const { return numLeafPages; }
+
+  /**
+   * Number of non-leaf pages in the index.
+   */
+  int getNumInternalPages() const { return numInternalPages; }
+
+  /**
+   * Smallest key in the index. Only meaningful when getNumEntries() > 0.
+   */
+  int getMinKey() const { return minKey; }
+
+  /**
+   * Largest key in the index. Only meaningful when getNumEntries() > 0.
+   */
+  int getMaxKey() const { return maxKey; }
+
+  /**
+   * Number of payload bytes (INCLUDE attributes) stored with each entry, 0 if the index is not covering.
+   */
+  int getPayloadSize() const { return payloadSize; }
+
+  /**
+   * Number of bytes of the trailing key attributes of a composite key, 0 for a single attribute key.
+   */
+  int getKeySuffixSize() const { return keySuffixSize; }
+
+  /**
+   * Layout of the leaf pages of the index.
+   */
+  LeafFormat getLeafFormat() const { return leafFormat; }
+
+  /**
+   * Number of overflow pages holding the rids of long posting lists, 0 unless the leaf format is POSTINGLEAF.
+   */
+  int getNumOverflowPages() const { return numOverflowPages; }
+
+  /**
+   * Number of pages of the Bloom filter, 0 if the index keeps none.
+   */
+  int getNumBloomPages() const { return bloomPageNos.size(); }
+
+  /**
+   * Number of segments of the learned routing layer, 0 if point lookups descend the tree.
+   */
+  int getNumLearnedSegments() const { return learnedSegments.size(); }
+
+  /**
+   * Size in bytes of an attribute stored in an index.
+   */
+  static int getAttrSize(const AttrDesc &attr);
+
+  /**
+   * Operation counters of the index since it was opened.
+   */
+  const IndexCounters &getCounters() const { return counters; }
+
+  /**
+   * Average number of entries per leaf, as a fraction of the entries a full leaf holds. Compressed leaves
+   * are measured against COMPRESSEDLEAFMAXENTRIES; posting leaves, whose capacity depends on the number
+   * of duplicates, against a slotted leaf.
+   */
+  double getAverageLeafFill() const;
+
+  /**
+   * Print the counters of the index, one per line.
+   */
+  void dumpCounters(std::ostream &out) const;
+
+  /**
+   * Print the kept operation traces, oldest first, one per line: the operation, its key, and every page
+   * read as pageNo@level, with a * for a buffer pool miss. Prints nothing but a note unless the index is
+   * compiled with BTREETRACE.
+   * @param onlyMisses  Only print the operations that missed the buffer pool, i.e. read from disk
+   */
+  void dumpTraces(std::ostream &out, bool onlyMisses = false) const;
+
+  /**
+   * Forget the kept operation traces.
+   */
+  void clearTraces();
 };
 
-}
\ No newline at end of file
+
+
+/**
+ * @brief Point-in-time view of an index, held for as long as the object lives. ScanCursors given the
+ * snapshot return the entries the index had when it was taken, while inserts from another thread go on.
+ * Leaves changed after that keep a copy of their former entries (copy on write) until no snapshot older
+ * than the change is left. Must be destroyed before the index.
+ */
+class IndexSnapshot {
+ public:
+  /**
+   * Take a snapshot, applying the insert buffer first so that the snapshot holds every entry inserted.
+   */
+  IndexSnapshot(BTreeIndex *index);
+
+  /**
+   * Release the snapshot, retiring the leaf versions kept only for it.
+   */
+  ~IndexSnapshot();
+
+  IndexSnapshot(const IndexSnapshot &) = delete;
+  IndexSnapshot &operator=(const IndexSnapshot &) = delete;
+
+  /**
+   * Epoch of the snapshot.
+   */
+  std::uint64_t getEpoch() const { return epoch; }
+
+ private:
+  BTreeIndex *index;
+  std::uint64_t epoch;
+};
+
+
+
+/**
+ * @brief Scan of one key range of an index, independent of the scan of the index itself and of other
+ * cursors. Cursors over the parts of a range cut by BTreeIndex::splitScanRange let several threads scan
+ * one range. A cursor copies its leaves out of the buffer pool CURSORPREFETCHLEAVES at a time, under the
+ * latch of the index, and keeps no page pinned in between. While cursors run on other threads the index
+ * must not be used otherwise, except for inserts and lookups; each descent and run of leaves holds the
+ * latch from start to end. Entries are read as they are when their leaf is copied, or as they were
+ * when an IndexSnapshot was taken. From its first batch to its last the cursor is inside an epoch of the
+ * buffer pool, so the leaf it is to copy next is not disposed of and reused under it.
+ */
+class ScanCursor {
+ public:
+  /**
+   * Set up a scan of range. No page is read until the first call of nextBatch.
+   * @param snapshot  Snapshot to read, NULL to read the leaves as they are. Must outlive the cursor.
+   */
+  ScanCursor(BTreeIndex *index, const ScanRange &range, const IndexSnapshot *snapshot = NULL);
+
+  /**
+   * Leave the epoch of the scan if it has not ended.
+   */
+  ~ScanCursor();
+
+  ScanCursor(const ScanCursor &) = delete;
+  ScanCursor &operator=(const ScanCursor &) = delete;
+
+  /**
+   * Fetch the next batch of entries of the range, in key order.
+   * @param outPairs  Array of at least maxPairs entries, filled with the (rid, key) pairs
+   * @param maxPairs  Maximum number of pairs to return
+   * @return  Number of pairs returned, at least 1
+   * @throws BadScanrangeException If maxPairs is not positive.
+   * @throws IndexScanCompletedException If no entries of the range are left.
+   */
+  int nextBatch(RIDKeyPair<int>* outPairs, const int maxPairs);
+
+ private:
+  /**
+   * Replace keys and rids by the entries of the next leaves in the chain, descending to the first leaf
+   * of the range on the first call.
+   */
+  void fetchLeaves();
+
+  /**
+   * Leave the epoch of the buffer pool entered when the scan started, if still inside it.
+   */
+  void leaveEpoch();
+
+  BTreeIndex *index;
+  ScanRange range;
+  const IndexSnapshot *snapshot;
+
+  /**
+   * Entries of the leaves copied last, and the position of the next one to return.
+   */
+  std::vector<int> keys;
+  std::vector<RecordId> rids;
+  size_t nextEntry;
+
+  /**
+   * Leaf to copy next, 0 once the end of the chain or of the range has been reached.
+   */
+  PageId nextPageNum;
+
+  /**
+   * True once the first leaf of the range has been found.
+   */
+  bool started;
+
+  /**
+   * Slot of the epoch the cursor is inside of, -1 before the scan starts and after it ends.
+   */
+  int epochSlot;
+};
+
+}
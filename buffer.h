@@ -9,6 +9,9 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "epoch.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 
 namespace badgerdb {
@@ -118,39 +121,148 @@ class BufDesc {
 
 
 /**
-* @brief Class to maintain statistics of buffer usage 
+* @brief Number of shards of every buffer statistic. Each thread counts into one shard, so threads
+* counting at the same time rarely share a cache line.
+*/
+const int BUFSTATSSHARDS = 16;
+
+/**
+* @brief Shard of the buffer statistics the calling thread counts into. Threads take the shards in
+* turn the first time they count.
+*/
+inline int bufStatsShard()
+{
+	static std::atomic<int> nextShard(0);
+	thread_local int shard = nextShard.fetch_add(1, std::memory_order_relaxed) % BUFSTATSSHARDS;
+	return shard;
+}
+
+/**
+* @brief 64-bit event counter split into per-thread shards. Counting is one relaxed atomic add to the
+* shard of the calling thread; reading it adds up the shards. Converts to its value, so it reads like a
+* plain integer.
+*/
+class ShardedCounter
+{
+ public:
+	ShardedCounter()
+	{
+		clear();
+	}
+
+	void add(std::uint64_t n)
+	{
+		shards[bufStatsShard()].value.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	void operator++(int)
+	{
+		add(1);
+	}
+
+	void operator+=(std::uint64_t n)
+	{
+		add(n);
+	}
+
+	std::uint64_t get() const
+	{
+		std::uint64_t sum = 0;
+		for (int i = 0; i < BUFSTATSSHARDS; i++)
+			sum += shards[i].value.load(std::memory_order_relaxed);
+		return sum;
+	}
+
+	operator std::uint64_t() const
+	{
+		return get();
+	}
+
+	void clear()
+	{
+		for (int i = 0; i < BUFSTATSSHARDS; i++)
+			shards[i].value.store(0, std::memory_order_relaxed);
+	}
+
+ private:
+	// padded rather than aligned, so that BufMgr needs no over-aligned new
+	struct Shard
+	{
+		std::atomic<std::uint64_t> value;
+		char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+	};
+
+	Shard shards[BUFSTATSSHARDS];
+};
+
+/**
+* @brief Fraction of buffer pool accesses that did not read the page from disk, 1 if there were none.
+* Reads from disk are clamped to the accesses, since allocs also count as reads.
+*/
+inline double bufHitRatio(std::uint64_t accesses, std::uint64_t diskreads)
+{
+	return accesses == 0 ? 1 : 1 - (double)std::min(diskreads, accesses) / accesses;
+}
+
+/**
+* @brief Values of the buffer statistics at one point in time, see BufStats.
+*/
+struct BufStatsSnapshot
+{
+	std::uint64_t accesses;
+	std::uint64_t diskreads;
+	std::uint64_t diskwrites;
+
+	/**
+	 * Fraction of accesses served from the buffer pool, see bufHitRatio.
+	 */
+	double hitRatio() const
+	{
+		return bufHitRatio(accesses, diskreads);
+	}
+};
+
+/**
+* @brief Class to maintain statistics of buffer usage. All counters are 64-bit and sharded per thread;
+* take a snapshot to read them all at once.
 */
 struct BufStats
 {
 	/**
    * Total number of accesses to buffer pool
 	 */
-  int accesses;
+  ShardedCounter accesses;
 
 	/**
    * Number of pages read from disk (including allocs)
 	 */
-  int diskreads;
+  ShardedCounter diskreads;
 
 	/**
    * Number of pages written back to disk
 	 */
-  int diskwrites;
+  ShardedCounter diskwrites;
 
 	/**
    * Clear all values 
 	 */
   void clear()
   {
-		accesses = diskreads = diskwrites = 0;
+		accesses.clear();
+		diskreads.clear();
+		diskwrites.clear();
   }
-      
+
 	/**
-   * Constructor of BufStats class 
+   * Read all values. Costs one load per shard and counter.
 	 */
-  BufStats()
+  BufStatsSnapshot snapshot() const
   {
-		clear();
+		BufStatsSnapshot s;
+		s.accesses = accesses;
+		s.diskreads = diskreads;
+		s.diskwrites = diskwrites;
+		return s;
   }
 };
 
@@ -186,6 +298,11 @@ class BufMgr
 	 */
   BufStats bufStats;
 
+	/**
+   * Epochs of the readers that keep page numbers of the pool without pinning them
+	 */
+  EpochManager epochs;
+
 	/**
    * Advance clock to next frame in the buffer pool
 	 */
@@ -270,6 +387,49 @@ class BufMgr
   void disposePage(File* file, const PageId PageNo);
 
 	/**
+	 * Dispose of a page once the readers inside an epoch now have left, so that neither its frame nor its
+	 * page number is reused while one of them may still read it. Readers enter epochs with getEpochs.
+	 * Like disposePage, the caller must be the only one using the buffer pool.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number, no longer reachable by readers entering from now on
+	 */
+  void retirePage(File* file, const PageId PageNo)
+  {
+		epochs.retire(file, [this, file, PageNo] { disposePage(file, PageNo); });
+		epochs.collect();
+  }
+
+	/**
+	 * Dispose of the retired pages no reader can still read. The caller must be the only one using the pool.
+	 *
+	 * @return Number of pages disposed of
+	 */
+  int reclaimPages()
+  {
+		return epochs.collect();
+  }
+
+	/**
+	 * Dispose of all retired pages of a file, for a file about to be closed that has no readers left.
+	 *
+	 * @param file   	File object
+	 * @return Number of pages disposed of
+	 */
+  int reclaimPages(const File* file)
+  {
+		return epochs.collectAll(file);
+  }
+
+	/**
+   * Epochs of the readers of the pool, shared by all files
+	 */
+  EpochManager & getEpochs()
+  {
+		return epochs;
+  }
+
+	/**
    * Print member variable values. 
 	 */
   void  printSelf();
@@ -282,6 +442,14 @@ class BufMgr
 		return bufStats;
   }
 
+	/**
+   * Get a copy of all buffer pool usage statistics, cheap enough to poll every second
+	 */
+  BufStatsSnapshot getBufStatsSnapshot() const
+  {
+		return bufStats.snapshot();
+  }
+
 	/**
    * Clear buffer pool usage statistics
 	 */
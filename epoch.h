@@ -0,0 +1,266 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <functional>
+
+namespace badgerdb
+{
+
+/**
+ * @brief Number of readers that can be inside an epoch on a slot of their own. Readers finding all
+ * slots taken share one overflow slot, which holds back reclamation until all of them have left.
+ */
+const int EPOCHSLOTS = 64;
+
+/**
+ * @brief Slot a thread tries first when entering an epoch. Threads take the slots in turn, so that
+ * up to EPOCHSLOTS threads get slots of their own.
+ */
+inline int epochSlotHint()
+{
+  static std::atomic<int> nextSlot(0);
+  thread_local int slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % EPOCHSLOTS;
+  return slot;
+}
+
+/**
+ * @brief Epoch-based reclamation. Readers that keep page numbers or pointers without pinning enter an
+ * epoch before they find them and leave it when done; a writer that unlinks something retires it with a
+ * function that frees it. The function runs once every reader that was inside an epoch when the thing was
+ * retired has left, since only those can still hold it.
+ *
+ * Entering and leaving are a compare-and-swap and a store to a slot of the reader's own, and nothing is
+ * counted per page. Retired functions run in collect, on the thread calling it, so a writer collects
+ * where it may free what it retired (for the buffer pool, while holding the latch the pool is used under).
+ */
+class EpochManager {
+ public:
+  EpochManager()
+    : globalEpoch(1), numRetired(0), overflowReaders(0), overflowEpoch(0)
+  {
+    for (int i = 0; i < EPOCHSLOTS; i++)
+    {
+      slots[i].epoch = 0;
+    }
+  }
+
+  /**
+   * Enter the current epoch. Nested entries take a slot each. Never waits: with all slots taken the
+   * reader joins the overflow slot.
+   * @return  Slot taken, to be given to leave
+   */
+  int enter()
+  {
+    int hint = epochSlotHint();
+    for (int i = 0; i < EPOCHSLOTS; i++)
+    {
+      int slot = (hint + i) % EPOCHSLOTS;
+      std::uint64_t free = 0;
+      if (slots[slot].epoch.load(std::memory_order_relaxed) == 0 &&
+          slots[slot].epoch.compare_exchange_strong(free, globalEpoch.load()))
+      {
+        return slot;
+      }
+    }
+    // the overflow slot keeps the epoch of its first reader, which is no later than that of the others
+    std::lock_guard<std::mutex> lock(overflowLock);
+    if (overflowReaders == 0)
+    {
+      overflowEpoch = globalEpoch.load();
+    }
+    overflowReaders++;
+    return EPOCHSLOTS;
+  }
+
+  /**
+   * Leave the epoch entered on the slot.
+   */
+  void leave(int slot)
+  {
+    if (slot == EPOCHSLOTS)
+    {
+      std::lock_guard<std::mutex> lock(overflowLock);
+      overflowReaders--;
+      return;
+    }
+    slots[slot].epoch.store(0, std::memory_order_release);
+  }
+
+  /**
+   * Have reclaim run once the readers now inside an epoch have all left. It must already be impossible
+   * for a reader entering from now on to find what reclaim frees.
+   * @param owner    File or structure the retired thing belongs to, for collectAll
+   * @param reclaim  Frees it
+   */
+  void retire(const void *owner, std::function<void()> reclaim)
+  {
+    std::lock_guard<std::mutex> lock(retiredLock);
+    // readers entering after this see a later epoch than the one retired
+    Retired entry = {globalEpoch.fetch_add(1), owner, reclaim};
+    retired.push_back(entry);
+    numRetired++;
+  }
+
+  /**
+   * Run the retired functions no reader can still need, oldest first.
+   * @return  Number of functions run
+   */
+  int collect()
+  {
+    if (numRetired == 0)
+    {
+      return 0;
+    }
+    std::vector<std::function<void()> > ready;
+    {
+      std::lock_guard<std::mutex> lock(retiredLock);
+      std::uint64_t oldest = oldestActiveEpoch();
+      while (!retired.empty() && retired.front().epoch < oldest)
+      {
+        ready.push_back(retired.front().reclaim);
+        retired.pop_front();
+      }
+      numRetired -= ready.size();
+    }
+    for (size_t i = 0; i < ready.size(); i++)
+    {
+      ready[i]();
+    }
+    return ready.size();
+  }
+
+  /**
+   * Run every retired function of an owner, whether readers are inside an epoch or not. For an owner
+   * that is being closed and has no readers left.
+   * @return  Number of functions run
+   */
+  int collectAll(const void *owner)
+  {
+    std::vector<std::function<void()> > ready;
+    {
+      std::lock_guard<std::mutex> lock(retiredLock);
+      std::deque<Retired> kept;
+      for (size_t i = 0; i < retired.size(); i++)
+      {
+        if (retired[i].owner == owner)
+        {
+          ready.push_back(retired[i].reclaim);
+        }
+        else
+        {
+          kept.push_back(retired[i]);
+        }
+      }
+      retired.swap(kept);
+      numRetired -= ready.size();
+    }
+    for (size_t i = 0; i < ready.size(); i++)
+    {
+      ready[i]();
+    }
+    return ready.size();
+  }
+
+  /**
+   * Current epoch.
+   */
+  std::uint64_t getEpoch() const { return globalEpoch; }
+
+  /**
+   * Number of retired functions that have not run yet.
+   */
+  size_t getNumRetired() const { return numRetired; }
+
+ private:
+  /**
+   * Oldest epoch a reader is inside of, or the current epoch if there is no reader.
+   */
+  std::uint64_t oldestActiveEpoch() const
+  {
+    std::uint64_t oldest = globalEpoch;
+    for (int i = 0; i < EPOCHSLOTS; i++)
+    {
+      std::uint64_t epoch = slots[i].epoch;
+      if (epoch != 0 && epoch < oldest)
+      {
+        oldest = epoch;
+      }
+    }
+    std::lock_guard<std::mutex> lock(overflowLock);
+    if (overflowReaders > 0 && overflowEpoch < oldest)
+    {
+      oldest = overflowEpoch;
+    }
+    return oldest;
+  }
+
+  /**
+   * Epoch a reader is inside of, 0 if the slot is free. Padded to a cache line so that readers on
+   * different slots do not share one; padded rather than aligned, so that BufMgr needs no over-aligned new.
+   */
+  struct Slot
+  {
+    std::atomic<std::uint64_t> epoch;
+    char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+  };
+
+  struct Retired
+  {
+    std::uint64_t epoch;
+    const void *owner;
+    std::function<void()> reclaim;
+  };
+
+  std::atomic<std::uint64_t> globalEpoch;
+  Slot slots[EPOCHSLOTS];
+
+  /**
+   * Retired functions in epoch order, guarded by retiredLock.
+   */
+  std::mutex retiredLock;
+  std::deque<Retired> retired;
+  std::atomic<size_t> numRetired;
+
+  /**
+   * Readers on the overflow slot, and an epoch no later than any of theirs. Guarded by overflowLock.
+   */
+  mutable std::mutex overflowLock;
+  int overflowReaders;
+  std::uint64_t overflowEpoch;
+};
+
+/**
+ * @brief Inside an epoch of an EpochManager for as long as the object lives.
+ */
+class EpochGuard {
+ public:
+  EpochGuard(EpochManager &epochs)
+    : epochs(epochs), slot(epochs.enter())
+  {
+  }
+
+  ~EpochGuard()
+  {
+    epochs.leave(slot);
+  }
+
+  EpochGuard(const EpochGuard &) = delete;
+  EpochGuard &operator=(const EpochGuard &) = delete;
+
+ private:
+  EpochManager &epochs;
+  int slot;
+};
+
+}
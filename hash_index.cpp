@@ -0,0 +1,413 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "hash_index.h"
+#include "filescan.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/end_of_file_exception.h"
+
+
+namespace badgerdb
+{
+
+// -----------------------------------------------------------------------------
+// HashIndex::HashIndex -- Constructor
+// -----------------------------------------------------------------------------
+
+HashIndex::HashIndex(const std::string & relationName,
+        std::string & outIndexName,
+        BufMgr *bufMgrIn,
+        const int attrByteOffset,
+        const Datatype attrType)
+{
+  bufMgr = bufMgrIn;
+  this->attrByteOffset = attrByteOffset;
+  attributeType = attrType;
+
+  std::ostringstream idxStr;
+  idxStr << relationName << "." << attrByteOffset << ".hash";
+  outIndexName = idxStr.str();
+
+  if (attrType != INTEGER)
+  {
+    throw BadIndexInfoException(outIndexName);
+  }
+
+  try
+  {
+    file = new BlobFile(outIndexName, false);
+    headerPageNum = file->getFirstPageNo();
+    Page *headerPage;
+    bufMgr->readPage(file, headerPageNum, headerPage);
+    HashIndexMetaInfo *meta = (HashIndexMetaInfo *)headerPage;
+
+    if (relationName != meta->relationName || attrType != meta->attrType
+      || attrByteOffset != meta->attrByteOffset || meta->formatVersion != HASHINDEXFORMATVERSION)
+    {
+      bufMgr->unPinPage(file, headerPageNum, false);
+      throw BadIndexInfoException(outIndexName);
+    }
+
+    level = meta->level;
+    splitBucket = meta->splitBucket;
+    numEntries = meta->numEntries;
+    numOverflowPages = meta->numOverflowPages;
+    dirPageNos.assign(meta->dirPageNos, meta->dirPageNos + meta->numDirPages);
+    bufMgr->unPinPage(file, headerPageNum, false);
+
+    // keep the directory in memory, so that a lookup only reads the bucket
+    int numBuckets = (1 << level) + splitBucket;
+    for (size_t i = 0; i < dirPageNos.size(); i++)
+    {
+      Page *dirPage;
+      bufMgr->readPage(file, dirPageNos[i], dirPage);
+      const PageId *pageNos = (const PageId *)dirPage;
+      int numInPage = std::min(HASHDIRSIZE, numBuckets - (int)bucketPageNos.size());
+      bucketPageNos.insert(bucketPageNos.end(), pageNos, pageNos + numInPage);
+      bufMgr->unPinPage(file, dirPageNos[i], false);
+    }
+  }
+  catch(const FileNotFoundException &e)
+  {
+    file = new BlobFile(outIndexName, true);
+
+    Page *headerPage;
+    bufMgr->allocPage(file, headerPageNum, headerPage);
+    HashIndexMetaInfo *meta = (HashIndexMetaInfo *)headerPage;
+    meta->attrByteOffset = attrByteOffset;
+    meta->attrType = attrType;
+    meta->formatVersion = HASHINDEXFORMATVERSION;
+    meta->numDirPages = 0;
+    strncpy((char *)(&(meta->relationName)), relationName.c_str(), 20);
+    meta->relationName[19] = 0;
+    bufMgr->unPinPage(file, headerPageNum, true);
+
+    // start out with a single empty bucket
+    level = 0;
+    splitBucket = 0;
+    numEntries = 0;
+    numOverflowPages = 0;
+    PageId bucketPageNum;
+    Page *bucketPage;
+    bufMgr->allocPage(file, bucketPageNum, bucketPage);
+    ((HashBucketInt *)bucketPage)->numEntries = 0;
+    ((HashBucketInt *)bucketPage)->overflowPageNo = 0;
+    bufMgr->unPinPage(file, bucketPageNum, true);
+    bucketPageNos.push_back(bucketPageNum);
+
+    //fill the newly created Blob File using filescan
+    FileScan fileScan(relationName, bufMgr);
+    RecordId rid;
+    try
+    {
+      while(1)
+      {
+        fileScan.scanNext(rid);
+        std::string record = fileScan.getRecord();
+        insertEntry(record.c_str() + attrByteOffset, rid);
+      }
+    }
+    catch(const EndOfFileException &e)
+    {
+      writeMetaInfo();
+      bufMgr->flushFile(file);
+    }
+  }
+}
+
+
+// -----------------------------------------------------------------------------
+// HashIndex::~HashIndex -- destructor
+// -----------------------------------------------------------------------------
+
+HashIndex::~HashIndex()
+{
+  writeMetaInfo();
+  bufMgr->flushFile(file);
+  delete file;
+  file = NULL;
+}
+
+
+
+void HashIndex::writeMetaInfo()
+{
+  // add directory pages as the number of buckets grows
+  int numDirPages = (bucketPageNos.size() + HASHDIRSIZE - 1) / HASHDIRSIZE;
+  while ((int)dirPageNos.size() < numDirPages)
+  {
+    PageId dirPageNum;
+    Page *dirPage;
+    bufMgr->allocPage(file, dirPageNum, dirPage);
+    bufMgr->unPinPage(file, dirPageNum, true);
+    dirPageNos.push_back(dirPageNum);
+  }
+  for (int i = 0; i < numDirPages; i++)
+  {
+    Page *dirPage;
+    bufMgr->readPage(file, dirPageNos[i], dirPage);
+    int numInPage = std::min(HASHDIRSIZE, (int)bucketPageNos.size() - i * HASHDIRSIZE);
+    std::copy(bucketPageNos.begin() + i * HASHDIRSIZE, bucketPageNos.begin() + i * HASHDIRSIZE + numInPage,
+      (PageId *)dirPage);
+    bufMgr->unPinPage(file, dirPageNos[i], true);
+  }
+
+  Page *headerPage;
+  bufMgr->readPage(file, headerPageNum, headerPage);
+  HashIndexMetaInfo *meta = (HashIndexMetaInfo *)headerPage;
+  meta->level = level;
+  meta->splitBucket = splitBucket;
+  meta->numEntries = numEntries;
+  meta->numOverflowPages = numOverflowPages;
+  meta->numDirPages = dirPageNos.size();
+  std::copy(dirPageNos.begin(), dirPageNos.end(), meta->dirPageNos);
+  bufMgr->unPinPage(file, headerPageNum, true);
+}
+
+
+
+int HashIndex::getBucket(int key) const
+{
+  std::uint64_t hash = hashKey(key);
+  int bucket = hash & ((1ULL << level) - 1);
+  if (bucket < splitBucket)
+  {
+    // already split in this round, one more bit tells the old bucket from the new one
+    bucket = hash & ((1ULL << (level + 1)) - 1);
+  }
+  return bucket;
+}
+
+
+
+void HashIndex::appendToBucket(PageId pageNum, int key, RecordId rid)
+{
+  Page *page;
+  bufMgr->readPage(file, pageNum, page);
+  HashBucketInt *bucket = (HashBucketInt *)page;
+  while (bucket->overflowPageNo != 0)
+  {
+    PageId nextPageNum = bucket->overflowPageNo;
+    bufMgr->unPinPage(file, pageNum, false);
+    pageNum = nextPageNum;
+    bufMgr->readPage(file, pageNum, page);
+    bucket = (HashBucketInt *)page;
+  }
+  if (bucket->numEntries == HASHBUCKETSIZE)
+  {
+    PageId newPageNum;
+    Page *newPage;
+    bufMgr->allocPage(file, newPageNum, newPage);
+    numOverflowPages++;
+    bucket->overflowPageNo = newPageNum;
+    bufMgr->unPinPage(file, pageNum, true);
+    pageNum = newPageNum;
+    bucket = (HashBucketInt *)newPage;
+    bucket->numEntries = 0;
+    bucket->overflowPageNo = 0;
+  }
+  bucket->keyArray[bucket->numEntries] = key;
+  bucket->ridArray[bucket->numEntries] = rid;
+  bucket->numEntries++;
+  bufMgr->unPinPage(file, pageNum, true);
+}
+
+
+
+void HashIndex::fillBucket(PageId pageNum, const std::vector<int> &keys, const std::vector<RecordId> &rids)
+{
+  Page *page;
+  bufMgr->readPage(file, pageNum, page);
+  HashBucketInt *bucket = (HashBucketInt *)page;
+
+  // free the overflow pages, the entries are written again from the start
+  PageId overflowPageNum = bucket->overflowPageNo;
+  while (overflowPageNum != 0)
+  {
+    Page *overflowPage;
+    bufMgr->readPage(file, overflowPageNum, overflowPage);
+    PageId nextPageNum = ((HashBucketInt *)overflowPage)->overflowPageNo;
+    bufMgr->unPinPage(file, overflowPageNum, false);
+    bufMgr->disposePage(file, overflowPageNum);
+    numOverflowPages--;
+    overflowPageNum = nextPageNum;
+  }
+
+  size_t next = 0;
+  while (true)
+  {
+    int numInPage = std::min((size_t)HASHBUCKETSIZE, keys.size() - next);
+    std::copy(keys.begin() + next, keys.begin() + next + numInPage, bucket->keyArray);
+    std::copy(rids.begin() + next, rids.begin() + next + numInPage, bucket->ridArray);
+    bucket->numEntries = numInPage;
+    bucket->overflowPageNo = 0;
+    next += numInPage;
+    if (next == keys.size())
+    {
+      break;
+    }
+    PageId newPageNum;
+    Page *newPage;
+    bufMgr->allocPage(file, newPageNum, newPage);
+    numOverflowPages++;
+    bucket->overflowPageNo = newPageNum;
+    bufMgr->unPinPage(file, pageNum, true);
+    pageNum = newPageNum;
+    bucket = (HashBucketInt *)newPage;
+  }
+  bufMgr->unPinPage(file, pageNum, true);
+}
+
+
+
+void HashIndex::splitNextBucket()
+{
+  PageId oldPageNum = bucketPageNos[splitBucket];
+  std::vector<int> keys[2];
+  std::vector<RecordId> rids[2];
+  PageId pageNum = oldPageNum;
+  while (pageNum != 0)
+  {
+    Page *page;
+    bufMgr->readPage(file, pageNum, page);
+    HashBucketInt *bucket = (HashBucketInt *)page;
+    for (int i = 0; i < bucket->numEntries; i++)
+    {
+      // the bit above the current level decides between the old and the new bucket
+      int half = (hashKey(bucket->keyArray[i]) >> level) & 1;
+      keys[half].push_back(bucket->keyArray[i]);
+      rids[half].push_back(bucket->ridArray[i]);
+    }
+    PageId nextPageNum = bucket->overflowPageNo;
+    bufMgr->unPinPage(file, pageNum, false);
+    pageNum = nextPageNum;
+  }
+
+  PageId newPageNum;
+  Page *newPage;
+  bufMgr->allocPage(file, newPageNum, newPage);
+  ((HashBucketInt *)newPage)->overflowPageNo = 0;
+  bufMgr->unPinPage(file, newPageNum, true);
+  bucketPageNos.push_back(newPageNum);
+  fillBucket(oldPageNum, keys[0], rids[0]);
+  fillBucket(newPageNum, keys[1], rids[1]);
+
+  splitBucket++;
+  if (splitBucket == (1 << level))
+  {
+    level++;
+    splitBucket = 0;
+  }
+}
+
+
+
+void HashIndex::insertEntry(const void *key, const RecordId rid)
+{
+  int intKey = *(const int *)key;
+  appendToBucket(bucketPageNos[getBucket(intKey)], intKey, rid);
+  numEntries++;
+
+  std::uint64_t capacity = bucketPageNos.size() * (std::uint64_t)HASHBUCKETSIZE * HASHMAXLOADPERCENT / 100;
+  if (numEntries > capacity && bucketPageNos.size() < (size_t)MAXHASHDIRPAGES * HASHDIRSIZE)
+  {
+    splitNextBucket();
+  }
+}
+
+
+
+bool HashIndex::searchBucket(PageId pageNum, int key, RecordId &outRid)
+{
+  while (pageNum != 0)
+  {
+    Page *page;
+    bufMgr->readPage(file, pageNum, page);
+    HashBucketInt *bucket = (HashBucketInt *)page;
+    const int *found = std::find(bucket->keyArray, bucket->keyArray + bucket->numEntries, key);
+    bool isFound = found != bucket->keyArray + bucket->numEntries;
+    if (isFound)
+    {
+      outRid = bucket->ridArray[found - bucket->keyArray];
+    }
+    PageId nextPageNum = bucket->overflowPageNo;
+    bufMgr->unPinPage(file, pageNum, false);
+    if (isFound)
+    {
+      return true;
+    }
+    pageNum = nextPageNum;
+  }
+  return false;
+}
+
+
+
+bool HashIndex::lookupEntry(const void *key, RecordId &outRid)
+{
+  int intKey = *(const int *)key;
+  return searchBucket(bucketPageNos[getBucket(intKey)], intKey, outRid);
+}
+
+
+
+int HashIndex::probeBatch(const int *keys, const int numKeys, RecordId *outRids, bool *outFound)
+{
+  std::vector<std::pair<int, int> > order(numKeys);
+  for (int i = 0; i < numKeys; i++)
+  {
+    outFound[i] = false;
+    order[i] = std::make_pair(getBucket(keys[i]), i);
+  }
+  std::sort(order.begin(), order.end());
+
+  int numFound = 0;
+  size_t groupStart = 0;
+  while (groupStart < order.size())
+  {
+    size_t groupEnd = groupStart;
+    while (groupEnd < order.size() && order[groupEnd].first == order[groupStart].first)
+    {
+      groupEnd++;
+    }
+
+    // read every page of the bucket once for all keys of the group
+    int numLeft = groupEnd - groupStart;
+    PageId pageNum = bucketPageNos[order[groupStart].first];
+    while (pageNum != 0 && numLeft > 0)
+    {
+      Page *page;
+      bufMgr->readPage(file, pageNum, page);
+      HashBucketInt *bucket = (HashBucketInt *)page;
+      for (size_t i = groupStart; i < groupEnd; i++)
+      {
+        int k = order[i].second;
+        if (outFound[k])
+        {
+          continue;
+        }
+        const int *found = std::find(bucket->keyArray, bucket->keyArray + bucket->numEntries, keys[k]);
+        if (found != bucket->keyArray + bucket->numEntries)
+        {
+          outRids[k] = bucket->ridArray[found - bucket->keyArray];
+          outFound[k] = true;
+          numFound++;
+          numLeft--;
+        }
+      }
+      PageId nextPageNum = bucket->overflowPageNo;
+      bufMgr->unPinPage(file, pageNum, false);
+      pageNum = nextPageNum;
+    }
+    groupStart = groupEnd;
+  }
+  return numFound;
+}
+
+}
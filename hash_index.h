@@ -0,0 +1,305 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Version of the on-disk hash index format. Stored in the meta page and checked when an
+ * existing hash index file is opened.
+ */
+const int HASHINDEXFORMATVERSION = 1;
+
+/**
+ * @brief Number of (key, rid) entries in a bucket page.
+ */
+//                                                      counter          overflow ptr            key          rid
+const int HASHBUCKETSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+
+/**
+ * @brief Number of bucket page numbers in a directory page.
+ */
+const int HASHDIRSIZE = Page::SIZE / sizeof( PageId );
+
+/**
+ * @brief Maximum number of directory pages. Once the directory is full, buckets stop splitting and
+ * grow overflow chains instead.
+ */
+const int MAXHASHDIRPAGES = 512;
+
+/**
+ * @brief Average bucket fill, in percent of HASHBUCKETSIZE, above which the next bucket is split.
+ */
+const int HASHMAXLOADPERCENT = 75;
+
+
+/**
+ * @brief The meta page of a hash index, the first page of the index file.
+ */
+struct HashIndexMetaInfo{
+  /**
+   * Name of base relation.
+   */
+  char relationName[20];
+
+  /**
+   * Offset of attribute, over which index is built, inside the record stored in pages.
+   */
+  int attrByteOffset;
+
+  /**
+   * Type of the attribute over which index is built.
+   */
+  Datatype attrType;
+
+  /**
+   * Version of the index format, HASHINDEXFORMATVERSION at the time the file was created.
+   */
+  int formatVersion;
+
+  /**
+   * Number of completed rounds of splits. Bucket numbers take level bits of the hash, or level+1 bits
+   * for the buckets already split in the current round.
+   */
+  int level;
+
+  /**
+   * Number of the next bucket to split in the current round.
+   */
+  int splitBucket;
+
+  /**
+   * Number of entries (key, rid pairs) in the index.
+   */
+  std::uint64_t numEntries;
+
+  /**
+   * Number of bucket overflow pages.
+   */
+  int numOverflowPages;
+
+  /**
+   * Number of directory pages in use.
+   */
+  int numDirPages;
+
+  /**
+   * Page numbers of the directory pages, which hold the page number of the primary page of every bucket.
+   */
+  PageId dirPageNos[MAXHASHDIRPAGES];
+};
+
+/**
+ * @brief Structure for bucket pages of a hash index on an INTEGER attribute. A bucket is a primary
+ * page followed by a chain of overflow pages with the same layout. Entries are unordered.
+ */
+struct HashBucketInt{
+  /**
+   * Number of entries in this page.
+   */
+  int numEntries;
+
+  /**
+   * Page number of the next page of the bucket, 0 for the last one.
+   */
+  PageId overflowPageNo;
+
+  /**
+   * Stores keys.
+   */
+  int keyArray[ HASHBUCKETSIZE ];
+
+  /**
+   * Stores RecordIds.
+   */
+  RecordId ridArray[ HASHBUCKETSIZE ];
+};
+
+
+/**
+ * @brief HashIndex class. It implements a linear hashing index on a single INTEGER attribute of a
+ * relation, for attributes that are only ever looked up by equality. A lookup reads one bucket page,
+ * plus its overflow pages if any.
+ */
+class HashIndex {
+
+ private:
+
+  /**
+   * File object for the index file.
+   */
+  File    *file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+  BufMgr  *bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+  PageId  headerPageNum;
+
+  /**
+   * Offset of attribute, over which index is built, inside records.
+   */
+  int     attrByteOffset;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+  Datatype  attributeType;
+
+  /**
+   * Page number of the primary page of every bucket, the directory pages held in memory.
+   */
+  std::vector<PageId> bucketPageNos;
+
+  /**
+   * Page numbers of the directory pages.
+   */
+  std::vector<PageId> dirPageNos;
+
+
+  // INDEX STATISTICS, MIRRORED FROM THE META PAGE
+
+  /**
+   * Number of completed rounds of splits.
+   */
+  int     level;
+
+  /**
+   * Number of the next bucket to split.
+   */
+  int     splitBucket;
+
+  /**
+   * Number of entries stored in the buckets.
+   */
+  std::uint64_t numEntries;
+
+  /**
+   * Number of bucket overflow pages.
+   */
+  int     numOverflowPages;
+
+  /**
+   * Copy the statistics kept in this object into the meta page, and the bucket page numbers into the
+   * directory pages.
+   */
+  void writeMetaInfo();
+
+  /**
+   * Number of the bucket a key belongs to.
+   */
+  int getBucket(int key) const;
+
+  /**
+   * Append an entry at the end of a bucket, adding an overflow page if the last page is full.
+   */
+  void appendToBucket(PageId pageNum, int key, RecordId rid);
+
+  /**
+   * Replace the contents of a bucket with the given entries, freeing its overflow pages.
+   */
+  void fillBucket(PageId pageNum, const std::vector<int> &keys, const std::vector<RecordId> &rids);
+
+  /**
+   * Split the next bucket of the current round, moving the entries whose next hash bit is set into a
+   * new bucket at the end.
+   */
+  void splitNextBucket();
+
+  /**
+   * Search the bucket starting at a page for a key.
+   * @param pageNum  Primary page of the bucket
+   * @param key      Key to look for
+   * @param outRid   Rid of the first entry with the key, if found
+   * @return  True if the bucket has an entry with the key
+   */
+  bool searchBucket(PageId pageNum, int key, RecordId &outRid);
+
+
+ public:
+
+  /**
+   * HashIndex Constructor.
+   * Check to see if the corresponding index file exists. If so, open the file.
+   * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn            Buffer Manager Instance
+   * @param attrByteOffset      Offset of attribute, over which index is to be built, in the record
+   * @param attrType            Datatype of attribute over which index is built, only INTEGER is supported
+   * @throws  BadIndexInfoException If an existing index file was built differently, or the attribute is not an INTEGER
+   */
+  HashIndex(const std::string & relationName, std::string & outIndexName,
+            BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType);
+
+  /**
+   * HashIndex Destructor.
+   * Write the meta page, flush the index file and delete the file object.
+   */
+  ~HashIndex();
+
+  /**
+   * Insert a new entry using the pair <key, rid>. Splits one bucket whenever the average bucket fill
+   * exceeds HASHMAXLOADPERCENT.
+   * @param key  Key to insert, pointer to integer.
+   * @param rid  Record ID of a record whose entry is getting inserted into the index.
+   */
+  void insertEntry(const void* key, const RecordId rid);
+
+  /**
+   * Look up one entry with the given key.
+   * @param key     Key, pointer to integer.
+   * @param outRid  Rid of an entry with the key, if found
+   * @return  True if the index has an entry with the key
+   */
+  bool lookupEntry(const void* key, RecordId& outRid);
+
+  /**
+   * Look up many keys at once. The keys are probed bucket by bucket, so that keys falling into the same
+   * bucket share one read of its pages.
+   * @param keys      Keys to look up
+   * @param numKeys   Number of keys
+   * @param outRids   Receives, for every key found, the rid of an entry with the key
+   * @param outFound  Receives for every key whether it was found
+   * @return  Number of keys found
+   */
+  int probeBatch(const int* keys, const int numKeys, RecordId* outRids, bool* outFound);
+
+
+  /**
+   * Number of entries (key, rid pairs) in the index.
+   */
+  std::uint64_t getNumEntries() const { return numEntries; }
+
+  /**
+   * Number of buckets in the index.
+   */
+  int getNumBuckets() const { return bucketPageNos.size(); }
+
+  /**
+   * Number of bucket overflow pages in the index.
+   */
+  int getNumOverflowPages() const { return numOverflowPages; }
+};
+
+}
@@ -0,0 +1,142 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace badgerdb
+{
+
+/**
+ * @brief Number of buckets each power of two is divided into, which bounds the relative error of a
+ * recorded value to 1/HISTOGRAMSUBBUCKETS.
+ */
+const int HISTOGRAMSUBBUCKETS = 16;
+
+/**
+ * @brief Number of buckets of a histogram, enough for any 64-bit value.
+ */
+const int HISTOGRAMBUCKETS = 64 * HISTOGRAMSUBBUCKETS;
+
+/**
+ * @brief Log-linear histogram of latencies (or any non-negative values), in the style of HdrHistogram.
+ * Values below HISTOGRAMSUBBUCKETS are counted exactly, larger ones in HISTOGRAMSUBBUCKETS buckets per
+ * power of two. Recording is a few shifts and an increment; histograms of different threads are
+ * combined with merge.
+ */
+class LatencyHistogram {
+ public:
+  LatencyHistogram()
+  {
+    clear();
+  }
+
+  /**
+   * Count one value.
+   */
+  void record(std::uint64_t value)
+  {
+    counts[bucketOf(value)]++;
+    totalCount++;
+    totalValue += value;
+    if (value > maxValue)
+    {
+      maxValue = value;
+    }
+  }
+
+  /**
+   * Add the counts of another histogram to this one.
+   */
+  void merge(const LatencyHistogram &other)
+  {
+    for (int i = 0; i < HISTOGRAMBUCKETS; i++)
+    {
+      counts[i] += other.counts[i];
+    }
+    totalCount += other.totalCount;
+    totalValue += other.totalValue;
+    if (other.maxValue > maxValue)
+    {
+      maxValue = other.maxValue;
+    }
+  }
+
+  /**
+   * Value below which the given percentage of the recorded values fall, to within the bucket width.
+   * @param percentile  Between 0 and 100, e.g. 99.9
+   */
+  std::uint64_t percentile(double percentile) const
+  {
+    std::uint64_t rank = (std::uint64_t)(percentile / 100 * totalCount);
+    if (rank >= totalCount)
+    {
+      return maxValue;
+    }
+    std::uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAMBUCKETS; i++)
+    {
+      seen += counts[i];
+      if (seen > rank)
+      {
+        return bucketValue(i) < maxValue ? bucketValue(i) : maxValue;
+      }
+    }
+    return maxValue;
+  }
+
+  std::uint64_t getCount() const { return totalCount; }
+
+  std::uint64_t getMax() const { return maxValue; }
+
+  double getMean() const { return totalCount == 0 ? 0 : (double)totalValue / totalCount; }
+
+  void clear()
+  {
+    memset(counts, 0, sizeof(counts));
+    totalCount = totalValue = maxValue = 0;
+  }
+
+ private:
+  std::uint64_t counts[HISTOGRAMBUCKETS];
+  std::uint64_t totalCount;
+  std::uint64_t totalValue;
+  std::uint64_t maxValue;
+
+  static int bucketOf(std::uint64_t value)
+  {
+    if (value < (std::uint64_t)HISTOGRAMSUBBUCKETS)
+    {
+      return value;
+    }
+    int msb = 0;
+    while (value >> (msb + 1))
+    {
+      msb++;
+    }
+    // the power of two, then the four bits below the top one
+    return (msb - 3) * HISTOGRAMSUBBUCKETS + ((value >> (msb - 4)) & (HISTOGRAMSUBBUCKETS - 1));
+  }
+
+  /**
+   * Largest value counted in a bucket.
+   */
+  static std::uint64_t bucketValue(int bucket)
+  {
+    if (bucket < HISTOGRAMSUBBUCKETS)
+    {
+      return bucket;
+    }
+    int msb = bucket / HISTOGRAMSUBBUCKETS + 3;
+    std::uint64_t sub = bucket % HISTOGRAMSUBBUCKETS;
+    return ((std::uint64_t)1 << msb | sub << (msb - 4)) + ((std::uint64_t)1 << (msb - 4)) - 1;
+  }
+};
+
+}
@@ -6,7 +6,14 @@
  */
 
 #include <vector>
+#include <algorithm>
+#include <climits>
+#include <thread>
+#include <atomic>
+#include <memory>
 #include "btree.h"
+#include "hash_index.h"
+#include "probe_executor.h"
 #include "page.h"
 #include "filescan.h"
 #include "page_iterator.h"
@@ -67,6 +74,7 @@ void createRelationForward();
 void intTestsNonConsecutive();
 void createRelationBackward();
 void createRelationRandom();
+void createRelationComposite(int groupSize);
 void createZeroRelationForward();
 void createRelationForwardRange(int start, int end);
 void intTestsNegative();
@@ -74,15 +82,51 @@ void intTests();
 void NonConsecutiveRelation();
 void intTestsEmpty();
 void intTestsOneLeaf();
+void intTestsStats();
+void intTestsCovering();
+void intTestsComposite();
+void intTestsPosting(int groupSize);
+void intTestsCompressed();
+void intTestsBloom(LeafFormat leafFormat);
+void intTestsHash();
+void intTestsLearned(LeafFormat leafFormat);
+void intTestsInsertBuffer();
+void intTestsBatch();
+void intTestsCounters();
+void intTestsRangeSplit(LeafFormat leafFormat);
+void intTestsProbeExecutor(LeafFormat leafFormat, int groupSize);
+void intTestsReadsBesideInserts(LeafFormat leafFormat);
+void intTestsSnapshotScan(LeafFormat leafFormat);
+void intTestsEpochs();
 void intTestOutOfBounds() ;
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int intScanOpen(BTreeIndex *index, const int *lowVal, Operator lowOp, const int *highVal, Operator highOp, ScanDirection direction = ASCENDING);
+int intScanBatch(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, ScanDirection direction = ASCENDING);
+int intScanSplit(BTreeIndex *index, const int *lowVal, Operator lowOp, const int *highVal, Operator highOp, int numRanges);
+int intScanSnapshot(BTreeIndex *index, const IndexSnapshot *snapshot, int &numOdd);
 void indexTests();
 void test1();
 void test2();
 void test3();
 void test4();
 void test5();
+void test6();
 void test7();
+void test8();
+void test9();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
 void intTestsNegative();
 void errorTests();
 void deleteRelation();
@@ -151,6 +195,22 @@ int main(int argc, char **argv)
 	test3();
 	test7();
   test4();
+	test6();
+	test8();
+	test9();
+	test10();
+	test11();
+	test12();
+	test13();
+	test14();
+	test15();
+	test16();
+	test17();
+	test18();
+	test19();
+	test20();
+	test21();
+	test22();
 
 	errorTests();
 
@@ -214,6 +274,17 @@ void test5()
 	std::cout << "\nTest 5 passed\n" << std::endl;
 }
 
+void test6()
+{
+  // Reopen an index and check that the tree statistics come back from the meta page
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test tree statistics on reopen" << std::endl;
+	createRelationRandom();
+	intTestsStats();
+	deleteRelation();
+	std::cout << "\nTest 6 passed\n" << std::endl;
+}
+
 void test7()
 {
   // Test for  for nonsecutive number
@@ -226,6 +297,185 @@ void test7()
 }
 
 
+void test8()
+{
+  // Covering index returning the double and string attributes from the leaves
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test covering index" << std::endl;
+	createRelationRandom();
+	intTestsCovering();
+	deleteRelation();
+	std::cout << "\nTest 8 passed\n" << std::endl;
+}
+
+void test9()
+{
+  // Composite key on the integer field followed by the double field
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test composite key" << std::endl;
+	createRelationComposite(10);
+	intTestsComposite();
+	deleteRelation();
+	std::cout << "\nTest 9 passed\n" << std::endl;
+}
+
+void test10()
+{
+  // Posting list leaves, with short lists and with lists long enough for overflow pages
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test posting list leaves" << std::endl;
+	createRelationComposite(10);
+	intTestsPosting(10);
+	deleteRelation();
+	createRelationComposite(2500);
+	intTestsPosting(2500);
+	deleteRelation();
+	std::cout << "\nTest 10 passed\n" << std::endl;
+}
+
+void test11()
+{
+  // Compressed leaves on randomly inserted dense keys
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test compressed leaves" << std::endl;
+	createRelationRandom();
+	intTestsCompressed();
+	deleteRelation();
+	std::cout << "\nTest 11 passed\n" << std::endl;
+}
+
+void test12()
+{
+  // Bloom filter with point lookups and batch probes, on every leaf format
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test Bloom filter and point lookups" << std::endl;
+	createRelationRandom();
+	intTestsBloom(SLOTTEDLEAF);
+	intTestsBloom(POSTINGLEAF);
+	intTestsBloom(COMPRESSEDLEAF);
+	deleteRelation();
+	std::cout << "\nTest 12 passed\n" << std::endl;
+}
+
+void test13()
+{
+  // Hash index point lookups and batch probes
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test hash index" << std::endl;
+	createRelationRandom();
+	intTestsHash();
+	deleteRelation();
+	std::cout << "\nTest 13 passed\n" << std::endl;
+}
+
+void test14()
+{
+  // Point lookups routed by the learned layer, before and after leaf splits
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test learned routing" << std::endl;
+	createRelationForward();
+	intTestsLearned(SLOTTEDLEAF);
+	intTestsLearned(COMPRESSEDLEAF);
+	deleteRelation();
+	std::cout << "\nTest 14 passed\n" << std::endl;
+}
+
+void test15()
+{
+  // Inserts held in memory and applied in key order
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test insert buffer" << std::endl;
+	createRelationRandom();
+	intTestsInsertBuffer();
+	deleteRelation();
+	std::cout << "\nTest 15 passed\n" << std::endl;
+}
+
+void test16()
+{
+  // Batch inserts, ascending past the largest key and shuffled into the middle
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test batch insert" << std::endl;
+	createRelationForward();
+	intTestsBatch();
+	deleteRelation();
+	std::cout << "\nTest 16 passed\n" << std::endl;
+}
+
+void test17()
+{
+  // Operation counters, and traces when compiled with BTREETRACE
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test index counters and traces" << std::endl;
+	createRelationRandom();
+	intTestsCounters();
+	deleteRelation();
+	std::cout << "\nTest 17 passed\n" << std::endl;
+}
+
+void test18()
+{
+  // Ranges split into parts scanned by independent cursors
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test parallel range split" << std::endl;
+	createRelationForward();
+	intTestsRangeSplit(SLOTTEDLEAF);
+	intTestsRangeSplit(POSTINGLEAF);
+	intTestsRangeSplit(COMPRESSEDLEAF);
+	deleteRelation();
+	std::cout << "\nTest 18 passed\n" << std::endl;
+}
+
+void test19()
+{
+  // Join probes run on several threads, with keys repeated across leaves
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test parallel probe executor" << std::endl;
+	createRelationComposite(10);
+	intTestsProbeExecutor(SLOTTEDLEAF, 10);
+	intTestsProbeExecutor(POSTINGLEAF, 10);
+	intTestsProbeExecutor(COMPRESSEDLEAF, 10);
+	deleteRelation();
+	std::cout << "\nTest 19 passed\n" << std::endl;
+}
+
+void test20()
+{
+  // Probes and split scans on several threads while another thread inserts and splits nodes
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test reads beside inserts" << std::endl;
+	NonConsecutiveRelation();
+	intTestsReadsBesideInserts(SLOTTEDLEAF);
+	intTestsReadsBesideInserts(COMPRESSEDLEAF);
+	deleteRelation();
+	std::cout << "\nTest 20 passed\n" << std::endl;
+}
+
+void test21()
+{
+  // Scans of snapshots while another thread inserts
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test snapshot scans beside inserts" << std::endl;
+	NonConsecutiveRelation();
+	intTestsSnapshotScan(SLOTTEDLEAF);
+	intTestsSnapshotScan(POSTINGLEAF);
+	intTestsSnapshotScan(COMPRESSEDLEAF);
+	deleteRelation();
+	std::cout << "\nTest 21 passed\n" << std::endl;
+}
+
+void test22()
+{
+  // Pages retired while a reader is inside an epoch are disposed of once it has left
+  std::cout << "---------------------" << std::endl;
+	std::cout << "Test epoch-based page reclamation" << std::endl;
+	NonConsecutiveRelation();
+	intTestsEpochs();
+	deleteRelation();
+	std::cout << "\nTest 22 passed\n" << std::endl;
+}
+
+
 // -----------------------------------------------------------------------------
 // createRelationForward
 // -----------------------------------------------------------------------------
@@ -476,6 +726,54 @@ void createRelationRandom()
 	file1->writePage(new_page_number, new_page);
 }
 
+// -----------------------------------------------------------------------------
+// createRelationComposite
+// -----------------------------------------------------------------------------
+
+void createRelationComposite(int groupSize)
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // groups of groupSize records share the integer, the double counts down inside a group
+  for(int val = 0; val < relationSize; val++)
+  {
+    sprintf(record1.s, "%05d string record", val);
+    record1.i = val / groupSize;
+    record1.d = groupSize - 1 - val % groupSize;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+      	file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+  }
+
+	file1->writePage(new_page_number, new_page);
+}
+
 // -----------------------------------------------------------------------------
 // indexTests
 // -----------------------------------------------------------------------------
@@ -509,6 +807,26 @@ void intTests()
 	checkPassFail(intScan(&index,0,GT,1,LT), 0)
 	checkPassFail(intScan(&index,300,GT,400,LT), 99)
 	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+
+	// scans with open bounds
+	int int3000 = 3000;
+	int int4000 = 4000;
+	checkPassFail(intScanOpen(&index,NULL,GTE,NULL,LTE), relationSize)
+	checkPassFail(intScanOpen(&index,NULL,GTE,&int3000,LT), 3000)
+	checkPassFail(intScanOpen(&index,&int4000,GT,NULL,LTE), relationSize - 4001)
+
+	// descending scans
+	int int25 = 25;
+	int int40 = 40;
+	checkPassFail(intScanOpen(&index,NULL,GTE,NULL,LTE,DESCENDING), relationSize)
+	checkPassFail(intScanOpen(&index,NULL,GTE,&int3000,LTE,DESCENDING), 3001)
+	checkPassFail(intScanOpen(&index,&int25,GT,&int40,LT,DESCENDING), 14)
+	checkPassFail(intScanOpen(&index,&int4000,GTE,NULL,LT,DESCENDING), relationSize - 4000)
+
+	// scans returning keys in batches
+	checkPassFail(intScanBatch(&index,25,GT,40,LT), 14)
+	checkPassFail(intScanBatch(&index,300,GT,400,LT), 99)
+	checkPassFail(intScanBatch(&index,3000,GTE,4000,LT,DESCENDING), 1000)
 }
 void intTestsEmpty()
 {
@@ -620,123 +938,1208 @@ void intTestsOneLeaf()
   
 }
 
-
-int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+void intTestsStats()
 {
-  RecordId scanRid;
-	Page *curPage;
-
-  std::cout << "Scan for ";
-  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
-  std::cout << lowVal << "," << highVal;
-  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
-  std::cout << std::endl;
-
-  int numResults = 0;
-	
+  std::cout << "Create a B+ Tree index and reopen it" << std::endl;
+  int height, numLeafPages, numInternalPages;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail(index.getNumEntries(), relationSize)
+    checkPassFail(index.getMinKey(), 0)
+    checkPassFail(index.getMaxKey(), relationSize - 1)
+    height = index.getHeight();
+    numLeafPages = index.getNumLeafPages();
+    numInternalPages = index.getNumInternalPages();
+    bool isMultiLevel = height > 1;
+    checkPassFail(isMultiLevel, true)
+  }
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail(index.getNumEntries(), relationSize)
+    checkPassFail(index.getMinKey(), 0)
+    checkPassFail(index.getMaxKey(), relationSize - 1)
+    checkPassFail(index.getHeight(), height)
+    checkPassFail(index.getNumLeafPages(), numLeafPages)
+    checkPassFail(index.getNumInternalPages(), numInternalPages)
+    checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+  }
 	try
 	{
-  	index->startScan(&lowVal, lowOp, &highVal, highOp);
-	}
-	catch(const NoSuchKeyFoundException &e)
-	{
-    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
-		return 0;
+		File::remove(intIndexName);
 	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
 
-	while(1)
+void intTestsCovering()
+{
+  std::cout << "Create a B+ Tree index on the integer field including the double and string fields" << std::endl;
+	IndexOptions options;
+	AttrDesc doubleAttr = { offsetof(tuple,d), DOUBLE, 0 };
+	AttrDesc stringAttr = { offsetof(tuple,s), STRING, 20 };
+	options.includeAttrs.push_back(doubleAttr);
+	options.includeAttrs.push_back(stringAttr);
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+	checkPassFail(index.getPayloadSize(), (int)(sizeof(double) + 20))
+
+	// the attributes come back from the leaves, the base relation is never read
+	RIDKeyPair<int> pairs[50];
+	char payloads[50 * (sizeof(double) + 20)];
+	int lowVal = 1000;
+	int highVal = 2000;
+	int numResults = 0;
+	int numMatching = 0;
+	index.startScan(&lowVal, GTE, &highVal, LT);
+	try
 	{
-		try
+		while(1)
 		{
-			index->scanNext(scanRid);
-			bufMgr->readPage(file1, scanRid.page_number, curPage);
-			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
-			bufMgr->unPinPage(file1, scanRid.page_number, false);
-
-			if( numResults < 5 )
-			{
-				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
-				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
-			}
-			else if( numResults == 5 )
+			int numPairs = index.scanNextBatch(pairs, 50, payloads);
+			for(int i = 0; i < numPairs; i++)
 			{
-				std::cout << "..." << std::endl;
+				const char *payload = payloads + i * index.getPayloadSize();
+				double d;
+				char s[21];
+				memcpy(&d, payload, sizeof(double));
+				memcpy(s, payload + sizeof(double), 20);
+				s[20] = 0;
+				sprintf(record1.s, "%05d string record", pairs[i].key);
+				if( d == (double)pairs[i].key && strncmp(s, record1.s, 20) == 0 )
+				{
+					numMatching++;
+				}
 			}
+			numResults += numPairs;
 		}
-		catch(const IndexScanCompletedException &e)
-		{
-			break;
-		}
-
-		numResults++;
 	}
+	catch(const IndexScanCompletedException &e)
+	{
+	}
+	index.endScan();
+	checkPassFail(numResults, 1000)
+	checkPassFail(numMatching, 1000)
+	checkPassFail(intScan(&index,300,GT,400,LT), 99)
 
-  if( numResults >= 5 )
+	// a plain index on the same field lives in a file of its own
+	{
+		std::string plainIndexName;
+		BTreeIndex plain(relationName, plainIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail((plainIndexName != intIndexName), true)
+		checkPassFail(plain.getPayloadSize(), 0)
+		checkPassFail(intScan(&plain,300,GT,400,LT), 99)
+		File::remove(plainIndexName);
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
   {
-    std::cout << "Number of results: " << numResults << std::endl;
   }
-  index->endScan();
-  std::cout << std::endl;
-
-	return numResults;
 }
 
-// -----------------------------------------------------------------------------
-// errorTests
-// -----------------------------------------------------------------------------
-
-void errorTests()
+void intTestsComposite()
 {
+  std::cout << "Create a B+ Tree index on the integer and double fields" << std::endl;
+	IndexOptions options;
+	AttrDesc doubleAttr = { offsetof(tuple,d), DOUBLE, 0 };
+	options.trailingKeyAttrs.push_back(doubleAttr);
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+	checkPassFail(index.getKeySuffixSize(), (int)sizeof(double))
+
+	// prefix scans on the integer field, entries of a group come back ordered by the double
+	RIDKeyPair<int> pairs[50];
+	char suffixes[50 * sizeof(double)];
+	int lowVal = 100;
+	int highVal = 200;
+	int numResults = 0;
+	int numOrdered = 0;
+	int prevKey = -1;
+	double prevD = 0;
+	index.startScan(&lowVal, GTE, &highVal, LT);
+	try
 	{
-		std::cout << "Error handling tests" << std::endl;
-		std::cout << "--------------------" << std::endl;
-		// Given error test
-
-		try
-		{
-			File::remove(relationName);
-		}
-		catch(const FileNotFoundException &e)
-		{
-		}
-
-		file1 = new PageFile(relationName, true);
-		
-		// initialize all of record1.s to keep purify happy
-		memset(record1.s, ' ', sizeof(record1.s));
-		PageId new_page_number;
-		Page new_page = file1->allocatePage(new_page_number);
-
-		// Insert a bunch of tuples into the relation.
-		for(int i = 0; i <10; i++ ) 
+		while(1)
 		{
-		  sprintf(record1.s, "%05d string record", i);
-		  record1.i = i;
-		  record1.d = (double)i;
-		  std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
-
-			while(1)
+			int numPairs = index.scanNextBatch(pairs, 50, NULL, suffixes);
+			for(int i = 0; i < numPairs; i++)
 			{
-				try
-				{
-		  		new_page.insertRecord(new_data);
-					break;
-				}
-				catch(const InsufficientSpaceException &e)
+				double d;
+				memcpy(&d, suffixes + i * sizeof(double), sizeof(double));
+				if( (pairs[i].key == prevKey && d == prevD + 1) || (pairs[i].key == prevKey + 1 && d == 0) || prevKey == -1 )
 				{
-					file1->writePage(new_page_number, new_page);
-					new_page = file1->allocatePage(new_page_number);
+					numOrdered++;
 				}
+				prevKey = pairs[i].key;
+				prevD = d;
 			}
+			numResults += numPairs;
 		}
+	}
+	catch(const IndexScanCompletedException &e)
+	{
+	}
+	index.endScan();
+	checkPassFail(numResults, 1000)
+	checkPassFail(numOrdered, 1000)
+	checkPassFail(intScan(&index,25,GT,40,LTE), 150)
+	checkPassFail(intScan(&index,499,GTE,499,LTE), 10)
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+void intTestsPosting(int groupSize)
+{
+  std::cout << "Create a B+ Tree index with posting list leaves on the integer field" << std::endl;
+	IndexOptions options;
+	options.leafFormat = POSTINGLEAF;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+	int numKeys = relationSize / groupSize;
+	checkPassFail((int)index.getNumEntries(), relationSize)
+	bool usesOverflow = index.getNumOverflowPages() > 0;
+	bool longLists = groupSize > 1000;
+	checkPassFail(usesOverflow, longLists)
+
+	checkPassFail(intScan(&index,0,GTE,numKeys,LT), relationSize)
+	checkPassFail(intScan(&index,1,GTE,1,LTE), groupSize)
+	checkPassFail(intScan(&index,0,GT,1,LTE), groupSize)
+	checkPassFail(intScanBatch(&index,0,GTE,numKeys,LT), relationSize)
+	checkPassFail(intScanBatch(&index,0,GTE,numKeys,LT,DESCENDING), relationSize)
+	checkPassFail(intScanBatch(&index,1,GTE,1,LTE,DESCENDING), groupSize)
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+void intTestsCompressed()
+{
+  std::cout << "Create a B+ Tree index with compressed leaves on the integer field" << std::endl;
+	IndexOptions options;
+	options.leafFormat = COMPRESSEDLEAF;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+
+	// fewer leaves than a slotted index would need even with every leaf full
+	bool fewerLeaves = index.getNumLeafPages() < relationSize / INTARRAYLEAFSIZE;
+	checkPassFail(fewerLeaves, true)
+
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	int int3000 = 3000;
+	checkPassFail(intScanOpen(&index,NULL,GTE,NULL,LTE), relationSize)
+	checkPassFail(intScanOpen(&index,NULL,GTE,&int3000,LTE,DESCENDING), 3001)
+	checkPassFail(intScanBatch(&index,0,GTE,relationSize,LT), relationSize)
+	checkPassFail(intScanBatch(&index,300,GT,400,LT,DESCENDING), 99)
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+
+void intTestsBloom(LeafFormat leafFormat)
+{
+  std::cout << "Create a B+ Tree index with a Bloom filter on the integer field" << std::endl;
+	IndexOptions options;
+	options.leafFormat = leafFormat;
+	options.bloomFilter = true;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		bool hasFilter = index.getNumBloomPages() > 0;
+		checkPassFail(hasFilter, true)
+
+		// the rid of a lookup must point at the record with that key
+		int key = 4321;
+		RecordId rid;
+		checkPassFail(index.lookupEntry(&key, rid), true)
+		Page *curPage;
+		bufMgr->readPage(file1, rid.page_number, curPage);
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rid).data()));
+		bufMgr->unPinPage(file1, rid.page_number, false);
+		checkPassFail(myRec.i, key)
+		key = relationSize + 10;
+		checkPassFail(index.lookupEntry(&key, rid), false)
+		checkPassFail(intScan(&index,relationSize + 10,GTE,relationSize + 10,LTE), 0)
+		checkPassFail(intScan(&index,77,GTE,77,LTE), 1)
+
+		// half of the probed keys are outside the relation
+		std::vector<int> keys;
+		for(int i = relationSize + relationSize / 2 - 1; i >= -relationSize / 2; i--)
+		{
+			keys.push_back(i);
+		}
+		std::vector<RecordId> rids(keys.size());
+		bool *found = new bool[keys.size()];
+		checkPassFail(index.probeBatch(&keys[0], keys.size(), &rids[0], found), relationSize)
+		bool foundMatches = found[relationSize / 2] && !found[0] && !found[keys.size() - 1];
+		checkPassFail(foundMatches, true)
+		delete[] found;
+
+		// keys inserted after the build are in the filter too
+		key = -7;
+		index.insertEntry(&key, rids[relationSize / 2]);
+		checkPassFail(index.mayContainKey(&key), true)
+	}
+	{
+		// the filter pages are found again when reopening
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		int key = -7;
+		RecordId rid;
+		checkPassFail(index.lookupEntry(&key, rid), true)
+		checkPassFail(intScan(&index,-7,GTE,-7,LTE), 1)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+
+void intTestsHash()
+{
+  std::cout << "Create a hash index on the integer field" << std::endl;
+	std::string hashIndexName;
+	{
+		HashIndex index(relationName, hashIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail((int)index.getNumEntries(), relationSize)
+		bool hasSplit = index.getNumBuckets() > 1;
+		checkPassFail(hasSplit, true)
+
+		// the rid of a lookup must point at the record with that key
+		int key = 1234;
+		RecordId rid;
+		checkPassFail(index.lookupEntry(&key, rid), true)
+		Page *curPage;
+		bufMgr->readPage(file1, rid.page_number, curPage);
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rid).data()));
+		bufMgr->unPinPage(file1, rid.page_number, false);
+		checkPassFail(myRec.i, key)
+		key = -1;
+		checkPassFail(index.lookupEntry(&key, rid), false)
+
+		// half of the probed keys are outside the relation
+		std::vector<int> keys;
+		for(int i = -relationSize / 2; i < relationSize + relationSize / 2; i++)
+		{
+			keys.push_back(i);
+		}
+		std::vector<RecordId> rids(keys.size());
+		bool *found = new bool[keys.size()];
+		checkPassFail(index.probeBatch(&keys[0], keys.size(), &rids[0], found), relationSize)
+		bool foundMatches = found[relationSize / 2] && !found[0] && !found[keys.size() - 1];
+		checkPassFail(foundMatches, true)
+		delete[] found;
+
+		key = -7;
+		index.insertEntry(&key, rids[relationSize / 2]);
+	}
+	{
+		// the directory is found again when reopening
+		HashIndex index(relationName, hashIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail((int)index.getNumEntries(), relationSize + 1)
+		int key = -7;
+		RecordId rid;
+		checkPassFail(index.lookupEntry(&key, rid), true)
+		key = 4999;
+		checkPassFail(index.lookupEntry(&key, rid), true)
+	}
+	try
+	{
+		File::remove(hashIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+
+void intTestsLearned(LeafFormat leafFormat)
+{
+  std::cout << "Create a B+ Tree index with learned routing on the integer field" << std::endl;
+	IndexOptions options;
+	options.leafFormat = leafFormat;
+	options.learnedRouting = true;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+
+	// evenly spread keys need a handful of segments at most
+	bool fewSegments = index.getNumLearnedSegments() > 0 && index.getNumLearnedSegments() <= 4;
+	checkPassFail(fewSegments, true)
+
+	std::vector<int> keys;
+	for(int i = -relationSize / 2; i < relationSize + relationSize / 2; i++)
+	{
+		keys.push_back(i);
+	}
+	std::vector<RecordId> rids(keys.size());
+	bool *found = new bool[keys.size()];
+	checkPassFail(index.probeBatch(&keys[0], keys.size(), &rids[0], found), relationSize)
+
+	// the rid of a lookup must point at the record with that key
+	int key = 2345;
+	RecordId rid;
+	checkPassFail(index.lookupEntry(&key, rid), true)
+	Page *curPage;
+	bufMgr->readPage(file1, rid.page_number, curPage);
+	RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rid).data()));
+	bufMgr->unPinPage(file1, rid.page_number, false);
+	checkPassFail(myRec.i, key)
+
+	// inserts split leaves, the segments they fall into are retrained
+	for(int i = relationSize; i < 3 * relationSize; i++)
+	{
+		index.insertEntry(&i, rids[relationSize / 2]);
+	}
+	for(int i = -relationSize; i < 0; i++)
+	{
+		index.insertEntry(&i, rids[relationSize / 2]);
+	}
+	keys.clear();
+	for(int i = -2 * relationSize; i < 4 * relationSize; i++)
+	{
+		keys.push_back(i);
+	}
+	rids.resize(keys.size());
+	delete[] found;
+	found = new bool[keys.size()];
+	checkPassFail(index.probeBatch(&keys[0], keys.size(), &rids[0], found), 4 * relationSize)
+	key = 3 * relationSize - 1;
+	checkPassFail(index.lookupEntry(&key, rid), true)
+	key = -relationSize - 1;
+	checkPassFail(index.lookupEntry(&key, rid), false)
+	delete[] found;
+
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+
+void intTestsInsertBuffer()
+{
+  std::cout << "Create a B+ Tree index with an insert buffer on the integer field" << std::endl;
+	IndexOptions options;
+	options.insertBufferSize = 1000;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScanBatch(&index,0,GTE,relationSize,LT), relationSize)
+
+		// entries still held in memory are found by lookups and counted
+		int key = 1234;
+		RecordId rid;
+		checkPassFail(index.lookupEntry(&key, rid), true)
+		// held entries are kept in key order as they arrive, whatever order they arrive in
+		int numHeldFound = 0;
+		for(int i = relationSize + 499; i >= relationSize; i--)
+		{
+			index.insertEntry(&i, rid);
+			key = relationSize + 499;
+			numHeldFound += index.lookupEntry(&i, rid) && index.lookupEntry(&key, rid);
+		}
+		checkPassFail(numHeldFound, 500)
+		checkPassFail((int)index.getNumEntries(), relationSize + 500)
+		key = relationSize + 250;
+		checkPassFail(index.lookupEntry(&key, rid), true)
+		std::vector<int> keys;
+		for(int i = 0; i < relationSize + 1000; i++)
+		{
+			keys.push_back(i);
+		}
+		std::vector<RecordId> rids(keys.size());
+		bool *found = new bool[keys.size()];
+		checkPassFail(index.probeBatch(&keys[0], keys.size(), &rids[0], found), relationSize + 500)
+		delete[] found;
+
+		// a scan applies them first
+		checkPassFail(intScan(&index,relationSize,GTE,relationSize + 1000,LT), 500)
+	}
+	{
+		// the destructor applied everything held
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		int key = 1234;
+		RecordId rid;
+		index.lookupEntry(&key, rid);
+		key = relationSize + 10;
+		index.insertEntry(&key, rid);
+	}
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail((int)index.getNumEntries(), relationSize + 501)
+		checkPassFail(intScan(&index,relationSize,GTE,relationSize + 1000,LT), 501)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+
+void intTestsBatch()
+{
+  std::cout << "Create a B+ Tree index on the integer field and insert batches" << std::endl;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	int key = 1234;
+	RecordId rid;
+	index.lookupEntry(&key, rid);
+
+	// ascending keys past the largest one leave nearly full leaves
+	std::vector<RIDKeyPair<int> > entries(4 * relationSize);
+	for(int i = 0; i < 4 * relationSize; i++)
+	{
+		entries[i].set(rid, relationSize + i);
+	}
+	index.insertBatch(&entries[0], entries.size());
+	checkPassFail((int)index.getNumEntries(), 5 * relationSize)
+	bool fullLeaves = index.getNumLeafPages() < 5 * relationSize / (INTARRAYLEAFSIZE * 8 / 10);
+	checkPassFail(fullLeaves, true)
+	checkPassFail(intScan(&index,relationSize - 10,GTE,relationSize + 10,LT), 20)
+
+	// shuffled keys, some already in the index, go to the leaves all over
+	entries.resize(2 * relationSize);
+	for(int i = 0; i < 2 * relationSize; i++)
+	{
+		entries[i].set(rid, (i * 7919) % (2 * relationSize) - relationSize);
+	}
+	index.insertBatch(&entries[0], entries.size());
+	checkPassFail((int)index.getNumEntries(), 7 * relationSize)
+	checkPassFail(intScan(&index,-10,GTE,10,LT), 30)
+	checkPassFail(intScan(&index,-relationSize,GTE,relationSize,LT), 3 * relationSize)
+	checkPassFail(intScan(&index,-relationSize,GTE,5 * relationSize,LT), 7 * relationSize)
+
+	// a batch counts all its inserts and is traced as one operation
+	std::ostringstream dump;
+	index.clearTraces();
+	index.insertBatch(&entries[0], 1);
+	index.dumpTraces(dump);
+	checkPassFail((int)index.getCounters().inserts, 7 * relationSize + 1)
+#ifdef BTREETRACE
+	checkPassFail(dump.str().compare(0, 6, "insert"), 0)
+#endif
+
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+void intTestsCounters()
+{
+  std::cout << "Create a B+ Tree index on the integer field and count its operations" << std::endl;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	// every insert walks down once, every leaf but the first comes from a split
+	const IndexCounters &counters = index.getCounters();
+	checkPassFail((int)counters.inserts, relationSize)
+	checkPassFail((int)counters.descents, relationSize)
+	checkPassFail((int)counters.splitsByLevel[0], index.getNumLeafPages() - 1)
+	bool halfFull = index.getAverageLeafFill() > 0.5 && index.getAverageLeafFill() <= 1;
+	checkPassFail(halfFull, true)
+
+	int key = 1234;
+	RecordId rid;
+	index.lookupEntry(&key, rid);
+	checkPassFail((int)counters.lookups, 1)
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail((int)counters.scans, 1)
+	checkPassFail((int)counters.descents, relationSize + 2)
+
+	std::ostringstream dump;
+	index.clearTraces();
+	index.lookupEntry(&key, rid);
+	index.dumpTraces(dump);
+#ifdef BTREETRACE
+	// root to leaf, one page per level
+	std::string line = dump.str();
+	int pagesRead = std::count(line.begin(), line.end(), '@');
+	checkPassFail(pagesRead, index.getHeight())
+	checkPassFail(line.compare(0, 15, "lookup key 1234"), 0)
+#else
+	checkPassFail(dump.str().compare(0, 7, "tracing"), 0)
+#endif
+
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+
+void intTestsRangeSplit(LeafFormat leafFormat)
+{
+  std::cout << "Create a B+ Tree index on the integer field and split ranges into parts" << std::endl;
+	IndexOptions options;
+	options.leafFormat = leafFormat;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+
+	// every leaf is a subtree of the root, the cuts come from the root
+	std::vector<ScanRange> ranges;
+	int numRanges = index.splitScanRange(NULL, GTE, NULL, LTE, 4, ranges);
+	bool someParts = numRanges > 1 && numRanges <= 4 && numRanges <= index.getNumLeafPages();
+	checkPassFail(someParts, true)
+	checkPassFail(ranges.front().lowBounded || ranges.back().highBounded, false)
+
+	int int25 = 25, int40 = 40, int2999 = 2999, int3000 = 3000;
+	checkPassFail(intScanSplit(&index,NULL,GTE,NULL,LTE,4), relationSize)
+	checkPassFail(intScanSplit(&index,&int25,GT,&int2999,LTE,3), 2974)
+	checkPassFail(intScanSplit(&index,&int25,GT,&int40,LT,8), 14)
+	checkPassFail(intScanSplit(&index,&int3000,GTE,NULL,LTE,16), relationSize - 3000)
+	checkPassFail(intScanSplit(&index,&int3000,GTE,&int3000,LTE,4), 1)
+	checkPassFail(intScanSplit(&index,NULL,GTE,&int40,LT,1), 40)
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+
+void intTestsProbeExecutor(LeafFormat leafFormat, int groupSize)
+{
+  std::cout << "Create a B+ Tree index on the integer field and probe it from several threads" << std::endl;
+	IndexOptions options;
+	options.leafFormat = leafFormat;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+
+	// shuffled probe keys, every key a few times, the ones past relationSize / groupSize missing
+	int numKeys = relationSize / groupSize;
+	std::vector<int> keys;
+	for (int j = 0; j < 3000; j++)
+	{
+		keys.push_back(j * 7 % 3000 % (numKeys + 100));
+	}
+	ProbeExecutor executor(&index, 4);
+	std::vector<ProbeMatch> matches;
+	int numMatches = executor.probe(&keys[0], keys.size(), matches);
+	int expected = 0;
+	for (size_t j = 0; j < keys.size(); j++)
+	{
+		expected += keys[j] < numKeys ? groupSize : 0;
+	}
+	checkPassFail(numMatches, expected)
+	checkPassFail((int)matches.size(), expected)
+
+	// every match is a record with the probe key, and every probe gets all its records
+	std::vector<int> matchesPerProbe(keys.size(), 0);
+	int wrongRecords = 0;
+	for (size_t m = 0; m < matches.size(); m++)
+	{
+		Page *curPage;
+		bufMgr->readPage(file1, matches[m].rid.page_number, curPage);
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(matches[m].rid).data()));
+		bufMgr->unPinPage(file1, matches[m].rid.page_number, false);
+		wrongRecords += myRec.i != keys[matches[m].probeIndex];
+		matchesPerProbe[matches[m].probeIndex]++;
+	}
+	checkPassFail(wrongRecords, 0)
+	int incompleteProbes = 0;
+	for (size_t j = 0; j < keys.size(); j++)
+	{
+		incompleteProbes += matchesPerProbe[j] != (keys[j] < numKeys ? groupSize : 0);
+	}
+	checkPassFail(incompleteProbes, 0)
+
+	// a second probe on the same executor, and one without keys
+	checkPassFail((int)executor.probe(&keys[0], 10, matches), 10 * groupSize)
+	checkPassFail((int)executor.probe(&keys[0], 0, matches), 0)
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+
+void intTestsReadsBesideInserts(LeafFormat leafFormat)
+{
+  std::cout << "Create a B+ Tree index on the even keys and read it while the odd keys are inserted" << std::endl;
+	IndexOptions options;
+	options.leafFormat = leafFormat;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+	int numEven = index.getNumEntries();
+	std::vector<int> evenKeys;
+	std::vector<int> oddKeys;
+	for (int i = 0; i < numEven; i++)
+	{
+		evenKeys.push_back(2 * i);
+		oddKeys.push_back(2 * i + 1);
+	}
+	std::random_shuffle(oddKeys.begin(), oddKeys.end());
+
+	// the even keys are there all along, every read has to find each of them exactly once
+	std::atomic<bool> inserting(true);
+	std::thread writer([&index, &oddKeys, &inserting] {
+		RecordId rid;
+		rid.page_number = 1;
+		rid.slot_number = 1;
+		for (size_t i = 0; i < oddKeys.size(); i++)
+		{
+			index.insertEntry(&oddKeys[i], rid);
+		}
+		inserting = false;
+	});
+	ProbeExecutor executor(&index, 4);
+	std::vector<ProbeMatch> matches;
+	RIDKeyPair<int> pairs[64];
+	int rounds = 0;
+	int wrongReads = 0;
+	do
+	{
+		std::vector<int> found(numEven, 0);
+		executor.probe(&evenKeys[0], numEven, matches);
+		for (size_t m = 0; m < matches.size(); m++)
+		{
+			found[matches[m].probeIndex]++;
+		}
+		wrongReads += std::count(found.begin(), found.end(), 1) != numEven;
+
+		// lookups hold the latch for the whole lookup
+		std::vector<RecordId> rids(numEven);
+		bool *probeFound = new bool[numEven];
+		wrongReads += index.probeBatch(&evenKeys[0], numEven, &rids[0], probeFound) != numEven;
+		delete[] probeFound;
+		for (int i = 0; i < numEven; i += 97)
+		{
+			wrongReads += !index.lookupEntry(&evenKeys[i], rids[i]);
+		}
+
+		std::vector<ScanRange> ranges;
+		index.splitScanRange(NULL, GTE, NULL, LTE, 4, ranges);
+		int evenScanned = 0;
+		for (size_t r = 0; r < ranges.size(); r++)
+		{
+			ScanCursor cursor(&index, ranges[r]);
+			try
+			{
+				while (1)
+				{
+					int numPairs = cursor.nextBatch(pairs, 64);
+					for (int i = 0; i < numPairs; i++)
+					{
+						evenScanned += pairs[i].key % 2 == 0;
+					}
+				}
+			}
+			catch(const IndexScanCompletedException &e)
+			{
+			}
+		}
+		wrongReads += evenScanned != numEven;
+		rounds++;
+	}
+	while (inserting);
+	writer.join();
+	std::cout << rounds << " rounds of reads" << std::endl;
+	checkPassFail(wrongReads, 0)
+	checkPassFail((int)index.getNumEntries(), 2 * numEven)
+	checkPassFail((int)executor.probe(&oddKeys[0], numEven, matches), numEven)
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+
+void intTestsSnapshotScan(LeafFormat leafFormat)
+{
+  std::cout << "Create a B+ Tree index on the even keys and scan snapshots of it while the odd keys are inserted" << std::endl;
+	IndexOptions options;
+	options.leafFormat = leafFormat;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+	int numEven = index.getNumEntries();
+	std::vector<int> oddKeys;
+	for (int i = 0; i < numEven; i++)
+	{
+		oddKeys.push_back(2 * i + 1);
+	}
+	std::random_shuffle(oddKeys.begin(), oddKeys.end());
+
+	int wrongReads = 0;
+	int numOdd;
+	{
+		// taken before the inserts, the snapshot holds the even keys only, however far the inserts have got
+		IndexSnapshot before(&index);
+		std::atomic<bool> inserting(true);
+		std::thread writer([&index, &oddKeys, &inserting] {
+			RecordId rid;
+			rid.page_number = 1;
+			rid.slot_number = 1;
+			for (size_t i = 0; i < oddKeys.size(); i++)
+			{
+				index.insertEntry(&oddKeys[i], rid);
+			}
+			inserting = false;
+		});
+		int rounds = 0;
+		int during = -1;
+		std::unique_ptr<IndexSnapshot> middle;
+		do
+		{
+			wrongReads += intScanSnapshot(&index, &before, numOdd) != numEven || numOdd != 0;
+			// a snapshot taken halfway returns the same entries every time
+			if (!middle)
+			{
+				middle.reset(new IndexSnapshot(&index));
+				during = intScanSnapshot(&index, middle.get(), numOdd);
+			}
+			wrongReads += intScanSnapshot(&index, middle.get(), numOdd) != during || during - numOdd != numEven;
+			rounds++;
+		}
+		while (inserting);
+		writer.join();
+		std::cout << rounds << " rounds of snapshot scans, " << index.getCounters().leafVersions << " leaf versions kept" << std::endl;
+		wrongReads += intScanSnapshot(&index, &before, numOdd) != numEven || numOdd != 0;
+		wrongReads += intScanSnapshot(&index, middle.get(), numOdd) != during;
+		checkPassFail(wrongReads, 0)
+	}
+	// with the snapshots gone the leaves are read as they are
+	IndexSnapshot after(&index);
+	checkPassFail(intScanSnapshot(&index, &after, numOdd), 2 * numEven)
+	checkPassFail(numOdd, numEven)
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+
+void intTestsEpochs()
+{
+  std::cout << "Retire with readers inside an epoch, then rebuild the Bloom filter of an index under a running cursor" << std::endl;
+	// a retired function waits for the readers that entered before it only
+	EpochManager epochs;
+	int numRun = 0;
+	int early = epochs.enter();
+	epochs.retire(NULL, [&numRun] { numRun++; });
+	int late = epochs.enter();
+	checkPassFail(epochs.collect(), 0)
+	epochs.leave(early);
+	checkPassFail(epochs.collect(), 1)
+	checkPassFail(numRun, 1)
+	epochs.leave(late);
+
+	// readers beyond the slots share the overflow slot, which holds back reclamation like the others
+	std::vector<int> slots;
+	for (int i = 0; i < EPOCHSLOTS + 6; i++)
+	{
+		slots.push_back(epochs.enter());
+	}
+	epochs.retire(NULL, [&numRun] { numRun++; });
+	for (int i = 0; i < EPOCHSLOTS; i++)
+	{
+		epochs.leave(slots[i]);
+	}
+	checkPassFail(epochs.collect(), 0)
+	for (int i = EPOCHSLOTS; i < EPOCHSLOTS + 6; i++)
+	{
+		epochs.leave(slots[i]);
+	}
+	checkPassFail(epochs.collect(), 1)
+	checkPassFail(numRun, 2)
+
+	IndexOptions options;
+	options.bloomFilter = true;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+	int numEven = index.getNumEntries();
+	RecordId rid;
+	rid.page_number = 1;
+	rid.slot_number = 1;
+	// more leaves than a cursor copies at a time, but not yet more keys than the filter was sized for
+	for (int key = 2 * numEven; key < 3 * numEven; key++)
+	{
+		index.insertEntry(&key, rid);
+	}
+	int scanned = 0;
+	{
+		ScanRange range;
+		range.lowBounded = false;
+		range.highBounded = false;
+		ScanCursor cursor(&index, range);
+		RIDKeyPair<int> pairs[64];
+		scanned += cursor.nextBatch(pairs, 64);
+
+		// enough inserts for the filter to outgrow its pages and be rebuilt, the old pages wait for the cursor
+		for (int key = 3 * numEven; key < 6 * numEven; key++)
+		{
+			index.insertEntry(&key, rid);
+		}
+		checkPassFail((bufMgr->getEpochs().getNumRetired() > 0), true)
+		try
+		{
+			while (1)
+			{
+				scanned += cursor.nextBatch(pairs, 64);
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+		}
+	}
+	checkPassFail(scanned, 5 * numEven)
+	checkPassFail((bufMgr->reclaimPages() > 0), true)
+	checkPassFail((int)bufMgr->getEpochs().getNumRetired(), 0)
+	// the rebuilt filter holds every key
+	int key = 6 * numEven - 1;
+	checkPassFail(index.mayContainKey(&key), true)
+
+	// more cursors halfway through their scans than there are epoch slots, finished on several threads
+	ScanRange range;
+	range.lowBounded = false;
+	range.highBounded = false;
+	std::vector<std::unique_ptr<ScanCursor> > cursors;
+	RIDKeyPair<int> pairs[64];
+	for (int i = 0; i < EPOCHSLOTS + 6; i++)
+	{
+		cursors.push_back(std::unique_ptr<ScanCursor>(new ScanCursor(&index, range)));
+		cursors[i]->nextBatch(pairs, 64);
+	}
+	std::atomic<int> fullScans(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.push_back(std::thread([&cursors, &fullScans, t, numEven] {
+			RIDKeyPair<int> pairs[64];
+			for (size_t i = t; i < cursors.size(); i += 4)
+			{
+				int scanned = 64;
+				try
+				{
+					while (1)
+					{
+						scanned += cursors[i]->nextBatch(pairs, 64);
+					}
+				}
+				catch(const IndexScanCompletedException &e)
+				{
+				}
+				fullScans += scanned == 5 * numEven;
+			}
+		}));
+	}
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+	checkPassFail(fullScans, EPOCHSLOTS + 6)
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+
+int intScanSnapshot(BTreeIndex *index, const IndexSnapshot *snapshot, int &numOdd)
+{
+	std::vector<ScanRange> ranges;
+	index->splitScanRange(NULL, GTE, NULL, LTE, 4, ranges);
+	RIDKeyPair<int> pairs[64];
+	int numResults = 0;
+	numOdd = 0;
+	int lastKey = -1;
+	for (size_t r = 0; r < ranges.size(); r++)
+	{
+		ScanCursor cursor(index, ranges[r], snapshot);
+		try
+		{
+			while (1)
+			{
+				int numPairs = cursor.nextBatch(pairs, 64);
+				for (int i = 0; i < numPairs; i++)
+				{
+					// keys are unique: out of order or repeated means a leaf was read twice
+					if (pairs[i].key <= lastKey)
+					{
+						return -1;
+					}
+					lastKey = pairs[i].key;
+					numOdd += pairs[i].key % 2;
+				}
+				numResults += numPairs;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+		}
+	}
+	return numResults;
+}
+
+
+int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  RecordId scanRid;
+	Page *curPage;
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+  int numResults = 0;
+	
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			if( numResults < 5 )
+			{
+				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
+			}
+			else if( numResults == 5 )
+			{
+				std::cout << "..." << std::endl;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  if( numResults >= 5 )
+  {
+    std::cout << "Number of results: " << numResults << std::endl;
+  }
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
+int intScanOpen(BTreeIndex * index, const int *lowVal, Operator lowOp, const int *highVal, Operator highOp, ScanDirection direction)
+{
+  RecordId scanRid;
+	Page *curPage;
+
+  std::cout << "Scan for ";
+  if( lowVal == NULL ) { std::cout << "(-inf"; } else if( lowOp == GT ) { std::cout << "(" << *lowVal; } else { std::cout << "[" << *lowVal; }
+  std::cout << ",";
+  if( highVal == NULL ) { std::cout << "+inf)"; } else if( highOp == LT ) { std::cout << *highVal << ")"; } else { std::cout << *highVal << "]"; }
+  if( direction == DESCENDING ) { std::cout << " descending"; }
+  std::cout << std::endl;
+
+  int numResults = 0;
+	int prevKey = 0;
+
+	try
+	{
+  	index->startScan(lowVal, lowOp, highVal, highOp, direction);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			// entries have to come back in key order
+			if( numResults > 0 && (direction == ASCENDING ? myRec.i < prevKey : myRec.i > prevKey) )
+			{
+				std::cout << "Key " << myRec.i << " returned after " << prevKey << std::endl;
+				index->endScan();
+				return -1;
+			}
+			prevKey = myRec.i;
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
+int intScanBatch(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, ScanDirection direction)
+{
+	RIDKeyPair<int> pairs[64];
+	Page *curPage;
+
+  std::cout << "Batch scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  if( direction == DESCENDING ) { std::cout << " descending"; }
+  std::cout << std::endl;
+
+  int numResults = 0;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp, direction);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		int numPairs;
+		try
+		{
+			numPairs = index->scanNextBatch(pairs, 64);
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		// the returned keys have to be the ones stored in the records
+		for(int i = 0; i < numPairs; i++)
+		{
+			bufMgr->readPage(file1, pairs[i].rid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(pairs[i].rid).data()));
+			bufMgr->unPinPage(file1, pairs[i].rid.page_number, false);
+			if( myRec.i != pairs[i].key )
+			{
+				std::cout << "Key " << pairs[i].key << " returned for record " << myRec.i << std::endl;
+				index->endScan();
+				return -1;
+			}
+		}
+		numResults += numPairs;
+	}
+
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// errorTests
+// -----------------------------------------------------------------------------
+
+void errorTests()
+{
+	{
+		std::cout << "Error handling tests" << std::endl;
+		std::cout << "--------------------" << std::endl;
+		// Given error test
+
+		try
+		{
+			File::remove(relationName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+
+		file1 = new PageFile(relationName, true);
+		
+		// initialize all of record1.s to keep purify happy
+		memset(record1.s, ' ', sizeof(record1.s));
+		PageId new_page_number;
+		Page new_page = file1->allocatePage(new_page_number);
+
+		// Insert a bunch of tuples into the relation.
+		for(int i = 0; i <10; i++ ) 
+		{
+		  sprintf(record1.s, "%05d string record", i);
+		  record1.i = i;
+		  record1.d = (double)i;
+		  std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+			while(1)
+			{
+				try
+				{
+		  		new_page.insertRecord(new_data);
+					break;
+				}
+				catch(const InsufficientSpaceException &e)
+				{
+					file1->writePage(new_page_number, new_page);
+					new_page = file1->allocatePage(new_page_number);
+				}
+			}
+		}
+
+		file1->writePage(new_page_number, new_page);
+
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		
+		int int2 = 2;
+		int int5 = 5;
 
-		file1->writePage(new_page_number, new_page);
-
-		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
-		
-		int int2 = 2;
-		int int5 = 5;
-
 		// Scan Tests
 		std::cout << "Call endScan before startScan" << std::endl;
 		try
@@ -795,6 +2198,33 @@ void errorTests()
 			std::cout << "BadScanrangeException Test 1 Passed." << std::endl;
 		}
 
+		std::cout << "Batch scan asking for no entries" << std::endl;
+		RIDKeyPair<int> pairs[1];
+		index.startScan(&int2, GTE, &int5, LTE);
+		try
+		{
+			index.scanNextBatch(pairs, 0);
+			std::cout << "BadScanrangeException Test 2 Failed." << std::endl;
+		}
+		catch(const BadScanrangeException &e)
+		{
+			std::cout << "BadScanrangeException Test 2 Passed." << std::endl;
+		}
+		index.endScan();
+
+		std::cout << "Cursor batch asking for no entries" << std::endl;
+		ScanRange range = {true, int2, GTE, true, int5, LTE, 0};
+		ScanCursor cursor(&index, range);
+		try
+		{
+			cursor.nextBatch(pairs, 0);
+			std::cout << "BadScanrangeException Test 3 Failed." << std::endl;
+		}
+		catch(const BadScanrangeException &e)
+		{
+			std::cout << "BadScanrangeException Test 3 Passed." << std::endl;
+		}
+
 		deleteRelation();
 	}
 
@@ -823,3 +2253,74 @@ void deleteRelation()
 	{
 	}
 }
+
+int intScanSplit(BTreeIndex * index, const int *lowVal, Operator lowOp, const int *highVal, Operator highOp, int numRanges)
+{
+	RIDKeyPair<int> pairs[64];
+	Page *curPage;
+
+	std::vector<ScanRange> ranges;
+	index->splitScanRange(lowVal, lowOp, highVal, highOp, numRanges, ranges);
+  std::cout << "Split scan in " << ranges.size() << " parts" << std::endl;
+
+	// the parts are scanned in turns, one batch at a time, each cursor on its own
+	std::vector<ScanCursor*> cursors;
+	std::vector<int> lastKeys;
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		cursors.push_back(new ScanCursor(index, ranges[i]));
+		lastKeys.push_back(INT_MIN);
+	}
+	int numResults = 0;
+	bool misordered = false;
+	for (size_t active = cursors.size(); active > 0; )
+	{
+		active = 0;
+		for (size_t c = 0; c < cursors.size(); c++)
+		{
+			if (cursors[c] == NULL)
+			{
+				continue;
+			}
+			int numPairs;
+			try
+			{
+				numPairs = cursors[c]->nextBatch(pairs, 64);
+			}
+			catch(const IndexScanCompletedException &e)
+			{
+				delete cursors[c];
+				cursors[c] = NULL;
+				continue;
+			}
+			active++;
+
+			// keys ascend within a part, parts do not overlap, and each key is the one stored in the record
+			for (int i = 0; i < numPairs; i++)
+			{
+				bufMgr->readPage(file1, pairs[i].rid.page_number, curPage);
+				RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(pairs[i].rid).data()));
+				bufMgr->unPinPage(file1, pairs[i].rid.page_number, false);
+				int key = pairs[i].key;
+				bool inPart = (!ranges[c].lowBounded || (ranges[c].lowOp == GT ? key > ranges[c].lowVal : key >= ranges[c].lowVal))
+					&& (!ranges[c].highBounded || (ranges[c].highOp == LT ? key < ranges[c].highVal : key <= ranges[c].highVal));
+				misordered = misordered || myRec.i != pairs[i].key || pairs[i].key < lastKeys[c] || !inPart;
+				lastKeys[c] = pairs[i].key;
+			}
+			numResults += numPairs;
+		}
+	}
+	for (size_t i = 1; i < ranges.size(); i++)
+	{
+		misordered = misordered || !ranges[i - 1].highBounded || !ranges[i].lowBounded || ranges[i - 1].highVal != ranges[i].lowVal;
+	}
+	if (misordered)
+	{
+		std::cout << "Split scan returned entries out of order or outside their part" << std::endl;
+		return -1;
+	}
+
+  std::cout << "Number of results: " << numResults << std::endl;
+  std::cout << std::endl;
+	return numResults;
+}
@@ -0,0 +1,287 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "probe_executor.h"
+
+namespace badgerdb
+{
+
+ProbeExecutor::ProbeExecutor(BTreeIndex *index, int numThreads)
+  : index(index), probeKeys(NULL), pendingTasks(0), numSteals(0), probeNumber(0), busyWorkers(0), stopping(false)
+{
+  numThreads = std::max(numThreads, 1);
+  for (int w = 0; w < numThreads; w++)
+  {
+    workers.push_back(new Worker());
+    workers[w]->nextPageNum = 0;
+  }
+  for (int w = 0; w < numThreads; w++)
+  {
+    threads.push_back(std::thread(&ProbeExecutor::workerLoop, this, w));
+  }
+}
+
+
+ProbeExecutor::~ProbeExecutor()
+{
+  {
+    std::lock_guard<std::mutex> lock(jobLock);
+    stopping = true;
+  }
+  jobReady.notify_all();
+  for (size_t w = 0; w < threads.size(); w++)
+  {
+    threads[w].join();
+    delete workers[w];
+  }
+}
+
+
+size_t ProbeExecutor::probe(const int *keys, size_t numKeys, std::vector<ProbeMatch> &outMatches)
+{
+  outMatches.clear();
+  index->counters.lookups += numKeys;
+  if (numKeys == 0)
+  {
+    return 0;
+  }
+  // the probes read the leaves only
+  index->flushInsertBuffer();
+
+  probeKeys = keys;
+  order.resize(numKeys);
+  for (size_t i = 0; i < numKeys; i++)
+  {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [keys](int i, int j) { return keys[i] < keys[j]; });
+
+  // one task per child of the root, the keys that descend into it
+  std::vector<ProbeTask> tasks;
+  size_t begin = 0;
+  std::unique_lock<std::recursive_mutex> latch(index->bufferLatch);
+  if (!index->isRootLeaf)
+  {
+    Page *page;
+    index->bufMgr->readPage(index->file, index->rootPageNum, page);
+    NonLeafNodeInt *root = (NonLeafNodeInt *)page;
+    PageId *pageNoArray = index->nodePageNos(root);
+    for (int i = 0; i < index->nodeOccupancy && pageNoArray[i + 1] != 0; i++)
+    {
+      // keys equal to a separator descend to its left
+      int separator = root->keyArray[i];
+      size_t end = std::upper_bound(order.begin() + begin, order.end(), separator,
+                                    [keys](int key, int k) { return key < keys[k]; }) - order.begin();
+      if (end > begin)
+      {
+        ProbeTask task = {begin, end};
+        tasks.push_back(task);
+      }
+      begin = end;
+    }
+    index->bufMgr->unPinPage(index->file, index->rootPageNum, false);
+  }
+  latch.unlock();
+  if (begin < numKeys)
+  {
+    ProbeTask task = {begin, numKeys};
+    tasks.push_back(task);
+  }
+
+  // neighbouring subtrees go to the same worker
+  for (size_t t = 0; t < tasks.size(); t++)
+  {
+    workers[t * workers.size() / tasks.size()]->tasks.push_back(tasks[t]);
+  }
+  for (size_t w = 0; w < workers.size(); w++)
+  {
+    workers[w]->matches.clear();
+    workers[w]->error = std::exception_ptr();
+  }
+  pendingTasks = tasks.size();
+  {
+    std::lock_guard<std::mutex> lock(jobLock);
+    probeNumber++;
+    busyWorkers = workers.size();
+  }
+  jobReady.notify_all();
+  {
+    std::unique_lock<std::mutex> lock(jobLock);
+    jobDone.wait(lock, [this] { return busyWorkers == 0; });
+  }
+
+  size_t numMatches = 0;
+  for (size_t w = 0; w < workers.size(); w++)
+  {
+    if (workers[w]->error)
+    {
+      std::rethrow_exception(workers[w]->error);
+    }
+    numMatches += workers[w]->matches.size();
+  }
+  outMatches.reserve(numMatches);
+  for (size_t w = 0; w < workers.size(); w++)
+  {
+    outMatches.insert(outMatches.end(), workers[w]->matches.begin(), workers[w]->matches.end());
+  }
+  return numMatches;
+}
+
+
+void ProbeExecutor::workerLoop(int w)
+{
+  std::uint64_t probesSeen = 0;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(jobLock);
+      jobReady.wait(lock, [this, probesSeen] { return stopping || probeNumber != probesSeen; });
+      if (stopping)
+      {
+        return;
+      }
+      probesSeen = probeNumber;
+    }
+    runTasks(*workers[w], w);
+    {
+      std::lock_guard<std::mutex> lock(jobLock);
+      if (--busyWorkers == 0)
+      {
+        jobDone.notify_all();
+      }
+    }
+  }
+}
+
+
+void ProbeExecutor::runTasks(Worker &worker, int w)
+{
+  while (pendingTasks > 0)
+  {
+    ProbeTask task;
+    if (!popTask(worker, task) && !stealTask(w, task))
+    {
+      // the remaining tasks are running on other workers, and may still be cut
+      std::this_thread::yield();
+      continue;
+    }
+    // run the first part of a large task and leave the rest in the queue, where it can be stolen
+    while (task.end - task.begin > (size_t)PROBETASKSPLIT)
+    {
+      ProbeTask rest = {task.begin + (task.end - task.begin) / 2, task.end};
+      task.end = rest.begin;
+      pendingTasks++;
+      std::lock_guard<std::mutex> lock(worker.queueLock);
+      worker.tasks.push_back(rest);
+    }
+    try
+    {
+      runTask(worker, task);
+    }
+    catch(...)
+    {
+      if (!worker.error)
+      {
+        worker.error = std::current_exception();
+      }
+    }
+    pendingTasks--;
+  }
+}
+
+
+bool ProbeExecutor::popTask(Worker &worker, ProbeTask &task)
+{
+  std::lock_guard<std::mutex> lock(worker.queueLock);
+  if (worker.tasks.empty())
+  {
+    return false;
+  }
+  task = worker.tasks.back();
+  worker.tasks.pop_back();
+  return true;
+}
+
+
+bool ProbeExecutor::stealTask(int w, ProbeTask &task)
+{
+  for (size_t i = 1; i < workers.size(); i++)
+  {
+    Worker &victim = *workers[(w + i) % workers.size()];
+    std::lock_guard<std::mutex> lock(victim.queueLock);
+    if (!victim.tasks.empty())
+    {
+      task = victim.tasks.front();
+      victim.tasks.pop_front();
+      numSteals++;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+void ProbeExecutor::runTask(Worker &worker, const ProbeTask &task)
+{
+  // the copied run and the leaf after it stay valid until the task is done
+  EpochGuard guard(index->bufMgr->getEpochs());
+  bool copied = false;
+  for (size_t i = task.begin; i < task.end; i++)
+  {
+    int probeIndex = order[i];
+    int key = probeKeys[probeIndex];
+    // keys come in order: a key past the copied run needs a new descent, a key equal to its last one
+    // can continue into the next leaf
+    if (!copied || (!worker.leafKeys.empty() && key > worker.leafKeys.back()))
+    {
+      fetchLeaves(worker, key, true);
+      copied = true;
+    }
+    else if (!worker.leafKeys.empty() && key == worker.leafKeys.back() && worker.nextPageNum != 0)
+    {
+      fetchLeaves(worker, key, false);
+    }
+    size_t pos = std::lower_bound(worker.leafKeys.begin(), worker.leafKeys.end(), key) - worker.leafKeys.begin();
+    for (; pos < worker.leafKeys.size() && worker.leafKeys[pos] == key; pos++)
+    {
+      ProbeMatch match = {probeIndex, worker.leafRids[pos]};
+      worker.matches.push_back(match);
+    }
+  }
+}
+
+
+void ProbeExecutor::fetchLeaves(Worker &worker, int key, bool descend)
+{
+  std::lock_guard<std::recursive_mutex> latch(index->bufferLatch);
+  PageId pageNum = worker.nextPageNum;
+  Page *page = NULL;
+  if (descend)
+  {
+    worker.leafKeys.clear();
+    worker.leafRids.clear();
+    index->descendToLeaf(key, pageNum, page);
+  }
+  // copy leaves until one holds a larger key, entries with the key can continue into the next leaf
+  do
+  {
+    if (page == NULL)
+    {
+      index->bufMgr->readPage(index->file, pageNum, page);
+    }
+    index->appendLeafEntries(page, worker.leafKeys, worker.leafRids);
+    PageId sibPageNum = ((LeafNodeInt *)page)->rightSibPageNo;
+    index->bufMgr->unPinPage(index->file, pageNum, false);
+    page = NULL;
+    pageNum = sibPageNum;
+  }
+  while (pageNum != 0 && (worker.leafKeys.empty() || worker.leafKeys.back() <= key));
+  worker.nextPageNum = pageNum;
+}
+
+}
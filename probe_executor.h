@@ -0,0 +1,174 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <cstdint>
+
+#include "types.h"
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Number of probe keys above which a task is cut in half before it is run, the second half being
+ * left for its worker or for another one to steal.
+ */
+const int PROBETASKSPLIT = 512;
+
+/**
+ * @brief A match of a parallel probe: the position of the probe key in the array of keys probed, and
+ * the rid of an index entry with that key.
+ */
+struct ProbeMatch{
+  int probeIndex;
+  RecordId rid;
+};
+
+/**
+ * @brief Runs the probes of an index nested-loop join on several threads.
+ *
+ * The probe keys are sorted and cut into one task per child of the root, the keys that child's subtree
+ * holds. Tasks are dealt out to the workers in key order, so each worker starts on neighbouring
+ * subtrees; a worker that runs out of tasks steals the oldest one of another worker, and a worker
+ * cuts large tasks in half so that there is something left to steal. Within a task the keys are probed
+ * in order against runs of leaves copied out of the buffer pool under the latch of the index, so keys
+ * falling into the same leaf share one descent and are matched without holding the latch. A descent
+ * holds the latch from the root down to the copied leaves, and a task runs inside an epoch of the buffer
+ * pool so that no page it still refers to is disposed of.
+ *
+ * Every worker appends its matches to its own buffer; the buffers are concatenated once all tasks are
+ * done. While a probe runs the index must not be used otherwise, except for inserts and lookups.
+ */
+class ProbeExecutor {
+ public:
+  /**
+   * Start the worker threads.
+   * @param index       Index to probe
+   * @param numThreads  Number of worker threads, at least 1
+   */
+  ProbeExecutor(BTreeIndex *index, int numThreads);
+
+  /**
+   * Stop and join the worker threads.
+   */
+  ~ProbeExecutor();
+
+  /**
+   * Look up every key and return all entries with that key. Waits for all workers to finish.
+   * @param keys        Keys to probe, in any order, duplicates allowed
+   * @param numKeys     Number of keys
+   * @param outMatches  Receives one match per entry found for every key, grouped by worker
+   * @return  Number of matches
+   */
+  size_t probe(const int *keys, size_t numKeys, std::vector<ProbeMatch> &outMatches);
+
+  /**
+   * Number of tasks taken from another worker's queue since the executor was started.
+   */
+  std::uint64_t getNumSteals() const { return numSteals; }
+
+ private:
+  /**
+   * A run of probe keys, positions begin to end-1 of the sorted order.
+   */
+  struct ProbeTask{
+    size_t begin;
+    size_t end;
+  };
+
+  /**
+   * Queue and output of one worker thread. The owner takes tasks from the back of its queue, other
+   * workers steal from the front.
+   */
+  struct Worker{
+    std::mutex queueLock;
+    std::deque<ProbeTask> tasks;
+    std::vector<ProbeMatch> matches;
+
+    /**
+     * Entries of the run of leaves copied last, and the leaf after it in the chain.
+     */
+    std::vector<int> leafKeys;
+    std::vector<RecordId> leafRids;
+    PageId nextPageNum;
+
+    /**
+     * First exception thrown by a task of this worker during the current probe.
+     */
+    std::exception_ptr error;
+  };
+
+  /**
+   * Body of worker thread w: wait for a probe, run tasks until none are left, report back.
+   */
+  void workerLoop(int w);
+
+  /**
+   * Run tasks of worker w, its own first and then stolen ones, until all tasks of the probe are done.
+   */
+  void runTasks(Worker &worker, int w);
+
+  /**
+   * Take a task from the back of the worker's own queue.
+   */
+  bool popTask(Worker &worker, ProbeTask &task);
+
+  /**
+   * Take a task from the front of the queue of another worker.
+   */
+  bool stealTask(int w, ProbeTask &task);
+
+  /**
+   * Probe the keys of a task in order and add their matches to the worker's buffer.
+   */
+  void runTask(Worker &worker, const ProbeTask &task);
+
+  /**
+   * Copy into the worker the leaf a key belongs in, or extend the copied run with the leaves after it
+   * while they can still hold the key.
+   */
+  void fetchLeaves(Worker &worker, int key, bool descend);
+
+  BTreeIndex *index;
+  std::vector<Worker*> workers;
+  std::vector<std::thread> threads;
+
+  /**
+   * Keys of the probe running, and their positions in key order.
+   */
+  const int *probeKeys;
+  std::vector<int> order;
+
+  /**
+   * Tasks of the probe running that are not done yet, including the halves of split tasks.
+   */
+  std::atomic<long> pendingTasks;
+
+  std::atomic<std::uint64_t> numSteals;
+
+  /**
+   * Hands probes to the workers: probeNumber counts the probes started, busyWorkers the workers that
+   * have not finished the current one.
+   */
+  std::mutex jobLock;
+  std::condition_variable jobReady;
+  std::condition_variable jobDone;
+  std::uint64_t probeNumber;
+  int busyWorkers;
+  bool stopping;
+};
+
+}
@@ -0,0 +1,173 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "workload.h"
+#include "btree.h"
+#include "file.h"
+#include "page.h"
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb
+{
+
+const char *distributionName(KeyDistribution dist)
+{
+  switch (dist)
+  {
+    case FORWARD: return "forward";
+    case BACKWARD: return "backward";
+    case RANDOM: return "random";
+    default: return "zipfian";
+  }
+}
+
+bool parseDistribution(const std::string &name, KeyDistribution &dist)
+{
+  const KeyDistribution all[] = {FORWARD, BACKWARD, RANDOM, ZIPFIAN};
+  for (KeyDistribution d : all)
+  {
+    if (name == distributionName(d))
+    {
+      dist = d;
+      return true;
+    }
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// ZipfianGenerator
+// -----------------------------------------------------------------------------
+
+ZipfianGenerator::ZipfianGenerator(std::uint64_t n, double theta)
+  : n(n), theta(theta)
+{
+  zetan = 0;
+  for (std::uint64_t i = 1; i <= n; i++)
+  {
+    zetan += 1 / std::pow((double)i, theta);
+  }
+  double zeta2 = 1 + 1 / std::pow(2.0, theta);
+  alpha = 1 / (1 - theta);
+  eta = n < 2 ? 0 : (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan);
+}
+
+std::uint64_t ZipfianGenerator::next(std::mt19937_64 &rng) const
+{
+  double u = std::uniform_real_distribution<double>(0, 1)(rng);
+  double uz = u * zetan;
+  std::uint64_t rank;
+  if (uz < 1 || n < 2)
+  {
+    rank = 0;
+  }
+  else if (uz < 1 + std::pow(0.5, theta))
+  {
+    rank = 1;
+  }
+  else
+  {
+    rank = std::min<std::uint64_t>(n - 1, (std::uint64_t)(n * std::pow(eta * u - eta + 1, alpha)));
+  }
+  return hashKey((int)rank) % n;
+}
+
+// -----------------------------------------------------------------------------
+// KeyGenerator
+// -----------------------------------------------------------------------------
+
+KeyGenerator::KeyGenerator(KeyDistribution dist, int numKeys, std::uint64_t seed)
+  : dist(dist), numKeys(numKeys), rng(seed)
+{
+  if (dist == RANDOM)
+  {
+    permutation.resize(numKeys);
+    for (int i = 0; i < numKeys; i++)
+    {
+      permutation[i] = i;
+    }
+    std::shuffle(permutation.begin(), permutation.end(), rng);
+  }
+  else if (dist == ZIPFIAN)
+  {
+    zipfian.push_back(ZipfianGenerator(numKeys));
+  }
+}
+
+int KeyGenerator::keyAt(int i)
+{
+  switch (dist)
+  {
+    case FORWARD: return i;
+    case BACKWARD: return numKeys - 1 - i;
+    case RANDOM: return permutation[i];
+    default: return zipfian[0].next(rng);
+  }
+}
+
+int KeyGenerator::nextKey()
+{
+  if (dist == ZIPFIAN)
+  {
+    return zipfian[0].next(rng);
+  }
+  return std::uniform_int_distribution<int>(0, numKeys - 1)(rng);
+}
+
+// -----------------------------------------------------------------------------
+// createWorkloadRelation
+// -----------------------------------------------------------------------------
+
+void createWorkloadRelation(const std::string &relationName, int numRecords, KeyDistribution dist, std::uint64_t seed)
+{
+  // destroy any old copies of relation file
+  try
+  {
+    File::remove(relationName);
+  }
+  catch(const FileNotFoundException &e)
+  {
+  }
+  PageFile file = PageFile::create(relationName);
+
+  WorkloadRecord record;
+  memset(&record, 0, sizeof(record));
+  PageId newPageNumber;
+  Page newPage = file.allocatePage(newPageNumber);
+
+  KeyGenerator keys(dist, numRecords, seed);
+  for (int i = 0; i < numRecords; i++)
+  {
+    int val = keys.keyAt(i);
+    sprintf(record.s, "%05d string record", val);
+    record.i = val;
+    record.d = val;
+    std::string newData(reinterpret_cast<char*>(&record), sizeof(record));
+
+    while (1)
+    {
+      try
+      {
+        newPage.insertRecord(newData);
+        break;
+      }
+      catch(const InsufficientSpaceException &e)
+      {
+        file.writePage(newPageNumber, newPage);
+        newPage = file.allocatePage(newPageNumber);
+      }
+    }
+  }
+
+  file.writePage(newPageNumber, newPage);
+}
+
+}
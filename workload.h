@@ -0,0 +1,130 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+
+#include "types.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Skew parameter of the Zipfian key distribution, the YCSB default.
+ */
+const double ZIPFIANTHETA = 0.99;
+
+/**
+ * @brief Key distribution enumeration type. Decides in which order the keys of a generated relation
+ * are stored, and which keys a workload looks up.
+ */
+enum KeyDistribution
+{
+  FORWARD,    // 0, 1, ..., n-1; lookups uniform over the keys
+  BACKWARD,   // n-1, ..., 1, 0; lookups uniform over the keys
+  RANDOM,     // a random permutation of 0..n-1; lookups uniform over the keys
+  ZIPFIAN     // keys drawn from a scrambled Zipfian, with duplicates; lookups drawn the same way
+};
+
+/**
+ * @brief Name of a key distribution, as accepted by parseDistribution.
+ */
+const char *distributionName(KeyDistribution dist);
+
+/**
+ * @brief Key distribution named by a string ("forward", "backward", "random" or "zipfian").
+ * @return  False if the name is not known
+ */
+bool parseDistribution(const std::string &name, KeyDistribution &dist);
+
+/**
+ * @brief Tuple layout of the generated relations, the same as the tuples of the tests in main.cpp.
+ */
+struct WorkloadRecord {
+  int i;
+  double d;
+  char s[64];
+};
+
+
+/**
+ * @brief Zipfian distribution over 0..n-1, with the generator of Gray et al. used by YCSB. Rank 0 is
+ * the most popular; ranks are scrambled with hashKey so that the hot keys are spread over the key range
+ * instead of all sitting in the first leaf.
+ */
+class ZipfianGenerator {
+ public:
+  /**
+   * Precompute the constants of the distribution, in O(n).
+   */
+  ZipfianGenerator(std::uint64_t n, double theta = ZIPFIANTHETA);
+
+  /**
+   * Draw the next value, scrambled.
+   */
+  std::uint64_t next(std::mt19937_64 &rng) const;
+
+ private:
+  std::uint64_t n;
+  double theta;
+  double alpha;
+  double zetan;
+  double eta;
+};
+
+
+/**
+ * @brief Generator of the keys of a workload over a relation of numKeys records.
+ */
+class KeyGenerator {
+ public:
+  KeyGenerator(KeyDistribution dist, int numKeys, std::uint64_t seed = 1);
+
+  /**
+   * Key of the i-th record of a relation generated with this distribution, 0 <= i < numKeys.
+   */
+  int keyAt(int i);
+
+  /**
+   * Next key to look up: uniform over 0..numKeys-1, or Zipfian for the ZIPFIAN distribution.
+   */
+  int nextKey();
+
+  /**
+   * Random number generator of this workload, for the callers that need other random choices.
+   */
+  std::mt19937_64 &getRng() { return rng; }
+
+ private:
+  KeyDistribution dist;
+  int numKeys;
+  std::mt19937_64 rng;
+
+  /**
+   * Key order of the RANDOM distribution.
+   */
+  std::vector<int> permutation;
+
+  /**
+   * Present for the ZIPFIAN distribution.
+   */
+  std::vector<ZipfianGenerator> zipfian;
+};
+
+
+/**
+ * @brief Create a relation of numRecords tuples, replacing any existing file with the same name. The
+ * integer attribute of the i-th tuple is keyAt(i) of a KeyGenerator with the same distribution and seed,
+ * the double attribute is the same value and the string attribute its formatted value.
+ */
+void createWorkloadRelation(const std::string &relationName, int numRecords, KeyDistribution dist, std::uint64_t seed = 1);
+
+}
@@ -0,0 +1,393 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * YCSB-like workload driver. Loads a relation and builds a B+ tree index on it, then runs a number of
+ * client threads against the one index, each issuing a mix of point reads, inserts and short scans.
+ * Reports throughput, latency percentiles per operation type and the buffer pool hit ratio sampled over
+ * the run, as JSON.
+ *
+ * The index and the buffer manager are not thread-safe, so clients take a latch on the whole index for
+ * each operation; the latencies include the time spent waiting for it, as a client would see it.
+ *
+ * Usage: ycsb [--records 100000] [--threads 4] [--ops 100000] [--workload readheavy|scanheavy|readonly|balanced]
+ *             [--dist forward|backward|random|zipfian] [--bufs 1000] [--scanlen 100] [--interval 100]
+ *             [--out results.json]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include "btree.h"
+#include "histogram.h"
+#include "workload.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Globals
+// -----------------------------------------------------------------------------
+const std::string relationName = "ycsbRel";
+
+/**
+ * Operation types of a workload.
+ */
+enum OpType
+{
+  READOP,
+  INSERTOP,
+  SCANOP,
+  NUMOPTYPES
+};
+
+const char *opNames[NUMOPTYPES] = {"read", "insert", "scan"};
+
+/**
+ * Operation mix of a workload, in percent of all operations.
+ */
+struct WorkloadMix {
+  const char *name;
+  int percent[NUMOPTYPES];
+};
+
+const WorkloadMix workloadMixes[] = {
+  {"readheavy", {95, 5, 0}},    // YCSB B, with inserts for updates
+  {"scanheavy", {0, 5, 95}},    // YCSB E
+  {"readonly", {100, 0, 0}},    // YCSB C
+  {"balanced", {50, 50, 0}}     // YCSB A, with inserts for updates
+};
+
+/**
+ * Buffer pool activity over one sampling interval.
+ */
+struct HitRatioSample {
+  double timeMs;
+  std::uint64_t accesses;
+  std::uint64_t misses;
+};
+
+BufMgr *bufMgr;
+BTreeIndex *btreeIndex;
+
+/**
+ * Latch on the index and the buffer manager, held for the whole of each operation.
+ */
+std::mutex indexMutex;
+
+std::atomic<bool> clientsDone(false);
+
+// -----------------------------------------------------------------------------
+// Forward declarations
+// -----------------------------------------------------------------------------
+void runClient(int clientId, long ops, const WorkloadMix &mix, int records, int scanLen,
+               const ZipfianGenerator *zipfian, LatencyHistogram *histograms);
+void sampleHitRatio(int intervalMs, std::vector<HitRatioSample> &samples);
+int scanRange(int lowVal, int highVal);
+
+int main(int argc, char **argv)
+{
+  int records = 100000;
+  int numThreads = 4;
+  long ops = 100000;
+  const WorkloadMix *mix = &workloadMixes[0];
+  KeyDistribution dist = ZIPFIAN;
+  int bufPages = 1000;
+  int scanLen = 100;
+  int intervalMs = 100;
+  const char *outName = NULL;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "--records") == 0)
+    {
+      records = atoi(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "--threads") == 0)
+    {
+      numThreads = atoi(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "--ops") == 0)
+    {
+      ops = atol(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "--bufs") == 0)
+    {
+      bufPages = atoi(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "--scanlen") == 0)
+    {
+      scanLen = atoi(argv[i + 1]);
+      if (scanLen <= 0)
+      {
+        std::cerr << "Scan length must be positive, not " << argv[i + 1] << std::endl;
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--interval") == 0)
+    {
+      intervalMs = atoi(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "--out") == 0)
+    {
+      outName = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "--dist") == 0)
+    {
+      if (!parseDistribution(argv[i + 1], dist))
+      {
+        std::cerr << "Unknown key distribution " << argv[i + 1] << std::endl;
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--workload") == 0)
+    {
+      mix = NULL;
+      for (const WorkloadMix &m : workloadMixes)
+      {
+        if (strcmp(argv[i + 1], m.name) == 0)
+        {
+          mix = &m;
+        }
+      }
+      if (mix == NULL)
+      {
+        std::cerr << "Unknown workload " << argv[i + 1] << std::endl;
+        return 1;
+      }
+    }
+    else
+    {
+      std::cerr << "Unknown option " << argv[i] << " " << argv[i + 1] << std::endl;
+      return 1;
+    }
+  }
+
+  // every key once, the Zipfian skew is in the requests only
+  createWorkloadRelation(relationName, records, dist == ZIPFIAN ? RANDOM : dist);
+  bufMgr = new BufMgr(bufPages);
+  std::string indexName;
+  std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+  btreeIndex = new BTreeIndex(relationName, indexName, bufMgr, offsetof(WorkloadRecord, i), INTEGER);
+  std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - loadStart;
+  std::cerr << "Loaded " << records << " records in " << loadTime.count() << " s" << std::endl;
+
+  std::vector<ZipfianGenerator> zipfian;
+  if (dist == ZIPFIAN)
+  {
+    zipfian.push_back(ZipfianGenerator(records));
+  }
+
+  std::vector<LatencyHistogram> histograms(numThreads * NUMOPTYPES);
+  std::vector<HitRatioSample> samples;
+  bufMgr->clearBufStats();
+  std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+  std::thread sampler(sampleHitRatio, intervalMs, std::ref(samples));
+  std::vector<std::thread> clients;
+  for (int i = 0; i < numThreads; i++)
+  {
+    clients.push_back(std::thread(runClient, i, ops, std::cref(*mix), records, scanLen,
+                                  zipfian.empty() ? NULL : &zipfian[0], &histograms[i * NUMOPTYPES]));
+  }
+  for (std::thread &client : clients)
+  {
+    client.join();
+  }
+  std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - runStart;
+  clientsDone = true;
+  sampler.join();
+
+  LatencyHistogram total[NUMOPTYPES];
+  for (int i = 0; i < numThreads; i++)
+  {
+    for (int op = 0; op < NUMOPTYPES; op++)
+    {
+      total[op].merge(histograms[i * NUMOPTYPES + op]);
+    }
+  }
+  BufStatsSnapshot bufStats = bufMgr->getBufStatsSnapshot();
+
+  std::ofstream outFile;
+  if (outName != NULL)
+  {
+    outFile.open(outName);
+  }
+  std::ostream &out = outName != NULL ? outFile : std::cout;
+  out << "{\n  \"context\": {\n"
+      << "    \"records\": " << records << ",\n"
+      << "    \"threads\": " << numThreads << ",\n"
+      << "    \"ops_per_thread\": " << ops << ",\n"
+      << "    \"workload\": \"" << mix->name << "\",\n"
+      << "    \"distribution\": \"" << distributionName(dist) << "\",\n"
+      << "    \"buffer_pages\": " << bufPages << ",\n"
+      << "    \"load_seconds\": " << loadTime.count() << "\n"
+      << "  },\n"
+      << "  \"run_seconds\": " << runTime.count() << ",\n"
+      << "  \"ops_per_second\": " << numThreads * ops / runTime.count() << ",\n"
+      << "  \"hit_ratio\": " << bufStats.hitRatio() << ",\n"
+      << "  \"disk_reads\": " << bufStats.diskreads << ",\n"
+      << "  \"disk_writes\": " << bufStats.diskwrites << ",\n"
+      << "  \"operations\": [";
+  bool first = true;
+  for (int op = 0; op < NUMOPTYPES; op++)
+  {
+    if (total[op].getCount() == 0)
+    {
+      continue;
+    }
+    out << (first ? "\n" : ",\n")
+        << "    {\"type\": \"" << opNames[op] << "\", \"count\": " << total[op].getCount()
+        << ", \"mean_ns\": " << total[op].getMean()
+        << ", \"p50_ns\": " << total[op].percentile(50)
+        << ", \"p99_ns\": " << total[op].percentile(99)
+        << ", \"p999_ns\": " << total[op].percentile(99.9)
+        << ", \"max_ns\": " << total[op].getMax() << "}";
+    first = false;
+  }
+  out << "\n  ],\n  \"hit_ratio_timeline\": [";
+  for (size_t i = 0; i < samples.size(); i++)
+  {
+    const HitRatioSample &s = samples[i];
+    out << (i == 0 ? "\n" : ",\n")
+        << "    {\"time_ms\": " << s.timeMs << ", \"accesses\": " << s.accesses
+        << ", \"hit_ratio\": " << bufHitRatio(s.accesses, s.misses) << "}";
+  }
+  out << "\n  ]\n}\n";
+
+  delete btreeIndex;
+  delete bufMgr;
+  try
+  {
+    File::remove(indexName);
+  }
+  catch(const FileNotFoundException &e)
+  {
+  }
+  try
+  {
+    File::remove(relationName);
+  }
+  catch(const FileNotFoundException &e)
+  {
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// runClient
+// -----------------------------------------------------------------------------
+
+void runClient(int clientId, long ops, const WorkloadMix &mix, int records, int scanLen,
+               const ZipfianGenerator *zipfian, LatencyHistogram *histograms)
+{
+  std::mt19937_64 rng(clientId + 1);
+  std::uniform_int_distribution<int> uniformKey(0, records - 1);
+  // inserted entries point at the first record, the index never reads the records
+  RecordId rid;
+  rid.page_number = 1;
+  rid.slot_number = 1;
+
+  for (long i = 0; i < ops; i++)
+  {
+    int dice = rng() % 100;
+    int op = 0;
+    while (op < NUMOPTYPES - 1 && dice >= mix.percent[op])
+    {
+      dice -= mix.percent[op];
+      op++;
+    }
+    int key = zipfian != NULL && op != INSERTOP ? zipfian->next(rng) : uniformKey(rng);
+    int len = 1 + rng() % scanLen;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+      std::lock_guard<std::mutex> latch(indexMutex);
+      if (op == READOP)
+      {
+        RecordId outRid;
+        btreeIndex->lookupEntry(&key, outRid);
+      }
+      else if (op == INSERTOP)
+      {
+        btreeIndex->insertEntry(&key, rid);
+      }
+      else
+      {
+        scanRange(key, key + len);
+      }
+    }
+    std::chrono::nanoseconds latency = std::chrono::steady_clock::now() - start;
+    histograms[op].record(latency.count());
+  }
+}
+
+// -----------------------------------------------------------------------------
+// sampleHitRatio
+// -----------------------------------------------------------------------------
+
+void sampleHitRatio(int intervalMs, std::vector<HitRatioSample> &samples)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::uint64_t lastAccesses = 0;
+  std::uint64_t lastMisses = 0;
+  while (!clientsDone)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    // the counters are sharded atomics, reading them does not need the index latch
+    HitRatioSample sample;
+    BufStatsSnapshot stats = bufMgr->getBufStatsSnapshot();
+    std::uint64_t misses = stats.diskreads;
+    std::uint64_t accesses = stats.accesses;
+    sample.accesses = accesses - lastAccesses;
+    sample.misses = misses - lastMisses;
+    lastAccesses = accesses;
+    lastMisses = misses;
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    sample.timeMs = elapsed.count();
+    samples.push_back(sample);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// scanRange
+// -----------------------------------------------------------------------------
+
+int scanRange(int lowVal, int highVal)
+{
+  RecordId scanRid;
+  int numResults = 0;
+  try
+  {
+    btreeIndex->startScan(&lowVal, GTE, &highVal, LT);
+  }
+  catch(const NoSuchKeyFoundException &e)
+  {
+    return 0;
+  }
+
+  while (1)
+  {
+    try
+    {
+      btreeIndex->scanNext(scanRid);
+      numResults++;
+    }
+    catch(const IndexScanCompletedException &e)
+    {
+      break;
+    }
+  }
+  btreeIndex->endScan();
+  return numResults;
+}